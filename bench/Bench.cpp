@@ -0,0 +1,485 @@
+// Benchmarks for the matcher and the CLI.
+//
+//   bench [--exe PATH] [--dir DIR] [--size MB] [--files N] [--runs N] [--no-grep]
+//
+// Generates a deterministic corpus under DIR, then times pattern compilation,
+// per-line matching (also with patterns compiled by StaticPattern), whole-file scanning with one and with many patterns, the
+// growth of scan time with input size for counted repetitions and,
+// when --exe is given, the CLI on single files and on a tree (-r), next to the
+// system `grep -E`, and its start-up time with and without a pattern cache.
+
+#include "Corpus.h"
+#include "FileScanner.h"
+#include "OutputSink.h"
+#include "PatternSet.h"
+#include "RegParser.h"
+#include "StaticPattern.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char **environ;
+
+namespace fs = std::filesystem;
+
+struct BenchConfig
+{
+    std::string exe;
+    std::string dir = "/tmp/grep-bench";
+    size_t size_mb = 64;
+    size_t files = 2000;
+    int runs = 3;
+    bool compare_grep = true;
+};
+
+struct Case
+{
+    const char *name;
+    const char *corpus; // file name below the corpus directory
+    const char *pattern;
+    const char *grep_pattern; // same language for grep -E, or nullptr
+};
+
+static const Case cases[] = {
+    {"log literal", "log.txt", "ERROR", "ERROR"},
+    {"log literal+class", "log.txt", "ERROR [[]worker-\\d+]", nullptr},
+    {"log status class", "log.txt", "status=5[0-9][0-9]", "status=5[0-9][0-9]"},
+    {"log alternation", "log.txt", "(POST|PUT) /api/v[0-9]+/users", "(POST|PUT) /api/v[0-9]+/users"},
+    {"log anchored", "log.txt", "^2024-01-0[1-3] 1", "^2024-01-0[1-3] 1"},
+    {"log no literal", "log.txt", "[a-z]+=[0-9]+ [a-z]+=x", "[a-z]+=[0-9]+ [a-z]+=x"},
+    {"log backref", "log.txt", "(\\d\\d):\\1:\\1", "([0-9][0-9]):\\1:\\1"},
+    {"source identifiers", "source.txt", "std::(vector|map)<", "std::(vector|map)<"},
+    {"source call", "source.txt", "[A-Za-z_]+[(]", "[A-Za-z_]+[(]"},
+    {"adversarial (a+)+b", "adversarial.txt", "(a+)+b", "(a+)+b"},
+    {"address counted", "address.txt", "\\d{1,3}(\\.\\d{1,3}){3}", "[0-9]{1,3}([.][0-9]{1,3}){3}"},
+    {"address backref", "address.txt", "(\\d+)\\.\\1\\.", "([0-9]+)[.]\\1[.]"},
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// best wall time of `runs` calls
+static double best_of(int runs, const std::function<void()> &fn)
+{
+    double best = 1e300;
+    for (int i = 0; i < runs; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        best = std::min(best, seconds_since(start));
+    }
+    return best;
+}
+
+static std::string read_all(const std::string &path)
+{
+    std::string data;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+        return data;
+    char chunk[1 << 16];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        data.append(chunk, n);
+    fclose(file);
+    return data;
+}
+
+// runs argv and discards its stdout; returns the exit status or -1. The output
+// goes through a pipe rather than to /dev/null, because GNU grep notices
+// /dev/null and stops at the first match as if -q had been given.
+static int run_quiet(const std::vector<std::string> &args)
+{
+    std::vector<char *> argv;
+    for (const auto &arg : args)
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0)
+        return -1;
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, pipe_fds[0]);
+    posix_spawn_file_actions_addclose(&actions, pipe_fds[1]);
+
+    pid_t pid;
+    int rc = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(pipe_fds[1]);
+    if (rc != 0)
+    {
+        close(pipe_fds[0]);
+        return -1;
+    }
+
+    char drain[1 << 16];
+    while (read(pipe_fds[0], drain, sizeof(drain)) > 0)
+    {
+    }
+    close(pipe_fds[0]);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void bench_compile(const BenchConfig &config)
+{
+    std::printf("\n== compile (RegParser construction + parse) ==\n");
+    const int iterations = 20000;
+    for (const auto &c : cases)
+    {
+        double t = best_of(config.runs, [&]
+                           {
+            for (int i = 0; i < iterations; ++i)
+            {
+                RegParser pattern(c.pattern);
+                pattern.parse();
+            } });
+        std::printf("%-22s %10.2f us/compile\n", c.name, t / iterations * 1e6);
+    }
+}
+
+// the first lines of a corpus file, without their '\n'
+static std::vector<std::string> read_lines(const std::string &path, size_t limit)
+{
+    std::string data = read_all(path);
+    std::vector<std::string> lines;
+    size_t pos = 0;
+    while (pos < data.size() && lines.size() < limit)
+    {
+        size_t nl = data.find('\n', pos);
+        if (nl == std::string::npos)
+            nl = data.size();
+        lines.emplace_back(data, pos, nl - pos);
+        pos = nl + 1;
+    }
+    return lines;
+}
+
+static void bench_match(const BenchConfig &config)
+{
+    std::printf("\n== per-line match (RegParser::match) ==\n");
+    for (const auto &c : cases)
+    {
+        std::vector<std::string> lines = read_lines(config.dir + "/" + c.corpus, 100000);
+
+        RegParser pattern(c.pattern);
+        pattern.parse();
+        size_t hits = 0;
+        double t = best_of(config.runs, [&]
+                           {
+            hits = 0;
+            for (const auto &line : lines)
+                hits += pattern.match(line);
+        });
+        std::printf("%-22s %10.1f ns/line  %8zu hits  [%s]\n", c.name, t / lines.size() * 1e9, hits,
+                    pattern.uses_dfa() ? "dfa" : "backtrack");
+    }
+}
+
+// the same lines through a pattern embedded at compile time and through RegParser
+template <FixedString Pattern>
+static void bench_static_case(const BenchConfig &config, const char *name, const char *corpus)
+{
+    std::vector<std::string> lines = read_lines(config.dir + "/" + corpus, 100000);
+    RegParser pattern(std::string(StaticPattern<Pattern>::source()));
+    pattern.parse();
+
+    size_t hits = 0;
+    size_t expected = 0;
+    double t_static = best_of(config.runs, [&]
+                              {
+        hits = 0;
+        for (const auto &line : lines)
+            hits += StaticPattern<Pattern>::match(line);
+    });
+    double t_dynamic = best_of(config.runs, [&]
+                               {
+        expected = 0;
+        for (const auto &line : lines)
+            expected += pattern.match(line);
+    });
+    std::printf("%-22s %10.1f %10.1f ns/line  %8zu hits%s\n", name, t_static / lines.size() * 1e9,
+                t_dynamic / lines.size() * 1e9, hits, hits == expected ? "" : "  MISMATCH");
+}
+
+static void bench_static(const BenchConfig &config)
+{
+    std::printf("\n== per-line match, StaticPattern vs RegParser ==\n");
+    std::printf("%-22s %10s %10s\n", "case", "static", "RegParser");
+    bench_static_case<"ERROR">(config, "log literal", "log.txt");
+    bench_static_case<"ERROR [[]worker-\\d+]">(config, "log literal+class", "log.txt");
+    bench_static_case<"status=5[0-9][0-9]">(config, "log status class", "log.txt");
+    bench_static_case<"(POST|PUT) /api/v[0-9]+/users">(config, "log alternation", "log.txt");
+    bench_static_case<"^2024-01-0[1-3] 1">(config, "log anchored", "log.txt");
+    bench_static_case<"[a-z]+=[0-9]+ [a-z]+=x">(config, "log no literal", "log.txt");
+    bench_static_case<"[A-Za-z_]+[(]">(config, "source call", "source.txt");
+    bench_static_case<"\\d{1,3}(\\.\\d{1,3}){3}">(config, "address counted", "address.txt");
+}
+
+static void bench_scan(const BenchConfig &config)
+{
+    std::printf("\n== whole-file scan (FileScanner, in process) ==\n");
+    int null_fd = open("/dev/null", O_WRONLY);
+    for (const auto &c : cases)
+    {
+        std::string path = config.dir + "/" + c.corpus;
+        double mb = static_cast<double>(fs::file_size(path)) / (1 << 20);
+
+        PatternSet pattern({c.pattern});
+        pattern.parse();
+        OutputSink sink(null_fd);
+        FileScanner scanner(pattern, &sink);
+        double t = best_of(config.runs, [&]
+                           {
+            int fd = open(path.c_str(), O_RDONLY);
+            scanner.scan_fd(fd);
+            close(fd); });
+        std::printf("%-22s %10.1f MB/s\n", c.name, mb / t);
+    }
+    close(null_fd);
+}
+
+static void bench_cli(const BenchConfig &config)
+{
+    std::printf("\n== CLI, single file (best of %d) ==\n", config.runs);
+    std::printf("%-22s %12s %12s %8s\n", "case", "exe MB/s", "grep MB/s", "ratio");
+    for (const auto &c : cases)
+    {
+        std::string path = config.dir + "/" + c.corpus;
+        double mb = static_cast<double>(fs::file_size(path)) / (1 << 20);
+
+        double ours = best_of(config.runs, [&]
+                              { run_quiet({config.exe, "-E", c.pattern, path}); });
+        double theirs = 0;
+        if (config.compare_grep && c.grep_pattern)
+            theirs = best_of(config.runs, [&]
+                             { run_quiet({"grep", "-E", c.grep_pattern, path}); });
+
+        if (theirs > 0)
+            std::printf("%-22s %12.1f %12.1f %8.2f\n", c.name, mb / ours, mb / theirs, theirs / ours);
+        else
+            std::printf("%-22s %12.1f %12s %8s\n", c.name, mb / ours, "n/a", "");
+    }
+
+    std::printf("\n== CLI, tree scan -r (best of %d) ==\n", config.runs);
+    std::string tree = config.dir + "/tree";
+    double mb = 0;
+    for (const auto &entry : fs::recursive_directory_iterator(tree))
+        if (entry.is_regular_file())
+            mb += static_cast<double>(entry.file_size()) / (1 << 20);
+
+    // the output modes only differ in how early they may stop reading
+    const std::pair<const char *, const char *> tree_cases[] = {
+        {nullptr, "ERROR"}, {nullptr, "std::(vector|map)<"}, {"-c", "ERROR"},
+        {"-l", "ERROR"},    {"-q", "ERROR"},                 {"-m1", "ERROR"}};
+    for (const auto &[flag, p] : tree_cases)
+    {
+        std::vector<std::string> ours_args = {config.exe, "-r"};
+        std::vector<std::string> grep_args = {"grep", "-r"};
+        if (flag)
+        {
+            ours_args.push_back(flag);
+            grep_args.push_back(flag);
+        }
+        for (auto *args : {&ours_args, &grep_args})
+            args->insert(args->end(), {"-E", p, tree});
+        std::string name = flag ? std::string(flag) + " " + p : p;
+
+        double ours = best_of(config.runs, [&]
+                              { run_quiet(ours_args); });
+        double theirs = config.compare_grep ? best_of(config.runs, [&]
+                                                      { run_quiet(grep_args); })
+                                            : 0;
+        if (theirs > 0)
+            std::printf("%-22s %12.1f %12.1f %8.2f\n", name.c_str(), mb / ours, mb / theirs, theirs / ours);
+        else
+            std::printf("%-22s %12.1f %12s %8s\n", name.c_str(), mb / ours, "n/a", "");
+    }
+}
+
+static void bench_multi(const BenchConfig &config)
+{
+    std::printf("\n== multi-pattern scan of log.txt (FileScanner, in process) ==\n");
+    std::string path = config.dir + "/log.txt";
+    double mb = static_cast<double>(fs::file_size(path)) / (1 << 20);
+    int null_fd = open("/dev/null", O_WRONLY);
+    for (size_t count : {10, 100, 1000, 10000})
+    {
+        std::vector<std::string> patterns = make_ioc_patterns(count, 42);
+        for (bool with_regex : {false, true})
+        {
+            if (with_regex)
+                patterns.push_back("status=5[0-9][0-9]");
+            PatternSet set(patterns);
+            set.parse();
+            OutputSink sink(null_fd);
+            FileScanner scanner(set, &sink);
+            double t = best_of(config.runs, [&]
+                               {
+                int fd = open(path.c_str(), O_RDONLY);
+                scanner.scan_fd(fd);
+                close(fd); });
+            std::printf("%6zu literals%-10s %10.1f MB/s\n", count, with_regex ? " + regex" : "", mb / t);
+        }
+    }
+    close(null_fd);
+
+    if (config.exe.empty())
+        return;
+    std::printf("\n== CLI, -f with 1000 literals (best of %d) ==\n", config.runs);
+    std::string pattern_file = config.dir + "/iocs.txt";
+    std::string iocs;
+    for (const auto &ioc : make_ioc_patterns(1000, 42))
+        iocs += ioc + "\n";
+    write_file(pattern_file, iocs);
+    double ours = best_of(config.runs, [&]
+                          { run_quiet({config.exe, "-f", pattern_file, path}); });
+    double theirs = config.compare_grep ? best_of(config.runs, [&]
+                                                  { run_quiet({"grep", "-F", "-f", pattern_file, path}); })
+                                        : 0;
+    if (theirs > 0)
+        std::printf("%-22s %12.1f %12.1f %8.2f\n", "-f iocs.txt", mb / ours, mb / theirs, theirs / ours);
+    else
+        std::printf("%-22s %12.1f %12s %8s\n", "-f iocs.txt", mb / ours, "n/a", "");
+}
+
+// Counted repetitions compile to copies of their element rather than to a
+// backtracking counter, so MB/s must stay flat as the input grows; run with
+// --size 1024 to cover a 1 GB file.
+static void bench_linear(const BenchConfig &config)
+{
+    std::printf("\n== counted repetition, scan time vs input size (RegParser::find_line) ==\n");
+    std::string data = read_all(config.dir + "/address.txt");
+    for (const char *pattern : {"\\d{1,3}(\\.\\d{1,3}){3}", "(\\d{1,3}\\.)\\1\\d{1,3}"})
+    {
+        RegParser regex(pattern);
+        regex.parse();
+        for (size_t parts : {8, 4, 2, 1})
+        {
+            // prefixes end on a line boundary
+            size_t size = data.find('\n', data.size() / parts);
+            size = size == std::string::npos ? data.size() : size + 1;
+            const char *end = data.data() + size;
+            size_t hits = 0;
+            double t = best_of(config.runs, [&]
+                               {
+                hits = 0;
+                const char *line = data.data();
+                while ((line = regex.find_line(line, end)) != nullptr)
+                {
+                    ++hits;
+                    const char *newline = static_cast<const char *>(memchr(line, '\n', static_cast<size_t>(end - line)));
+                    if (!newline)
+                        break;
+                    line = newline + 1;
+                } });
+            std::printf("%-26s %8.1f MB %10.1f MB/s  %8zu hits  [%s]\n", pattern, size / double(1 << 20),
+                        size / double(1 << 20) / t, hits, regex.uses_dfa() ? "dfa" : "backtrack");
+        }
+    }
+}
+
+// Short-lived runs with a long pattern list: mostly process start-up and
+// pattern compilation, with and without the --cache-dir entry from a warm-up run.
+static void bench_startup(const BenchConfig &config)
+{
+    std::printf("\n== CLI start-up, -f with 300 regexes on a one-line file (best of %d) ==\n", config.runs);
+    std::string pattern_file = config.dir + "/routes.txt";
+    std::string routes;
+    for (const auto &route : make_route_patterns(300, 42))
+        routes += route + "\n";
+    write_file(pattern_file, routes);
+    std::string input = config.dir + "/one-line.txt";
+    write_file(input, "2024-01-01 00:00:00.000 INFO [worker-1] GET /api/v1/users/1 status=200\n");
+    std::string cache_dir = config.dir + "/pattern-cache";
+    fs::remove_all(cache_dir);
+    run_quiet({config.exe, "--cache-dir", cache_dir, "-f", pattern_file, input});
+
+    const int batch = 20;
+    double cold = best_of(config.runs, [&]
+                          { for (int i = 0; i < batch; ++i) run_quiet({config.exe, "-f", pattern_file, input}); });
+    double cached = best_of(config.runs, [&]
+                            { for (int i = 0; i < batch; ++i) run_quiet({config.exe, "--cache-dir", cache_dir, "-f", pattern_file, input}); });
+    std::printf("%-22s %10.2f ms/run\n", "compiled every run", cold / batch * 1e3);
+    std::printf("%-22s %10.2f ms/run\n", "--cache-dir", cached / batch * 1e3);
+}
+
+static bool parse_args(int argc, char *argv[], BenchConfig &config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--exe" && has_value)
+            config.exe = argv[++i];
+        else if (arg == "--dir" && has_value)
+            config.dir = argv[++i];
+        else if (arg == "--size" && has_value)
+            config.size_mb = std::stoul(argv[++i]);
+        else if (arg == "--files" && has_value)
+            config.files = std::stoul(argv[++i]);
+        else if (arg == "--runs" && has_value)
+            config.runs = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--no-grep")
+            config.compare_grep = false;
+        else
+        {
+            std::fprintf(stderr, "usage: bench [--exe PATH] [--dir DIR] [--size MB] [--files N] [--runs N] [--no-grep]\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    BenchConfig config;
+    if (!parse_args(argc, argv, config))
+        return 2;
+
+    const uint64_t seed = 42;
+    const size_t bytes = config.size_mb << 20;
+    fs::create_directories(config.dir);
+    std::printf("corpus: %s (%zu MB per file, %zu tree files, seed %llu)\n", config.dir.c_str(), config.size_mb,
+                config.files, static_cast<unsigned long long>(seed));
+    if (!write_file(config.dir + "/log.txt", make_log_lines(bytes, seed)) ||
+        !write_file(config.dir + "/source.txt", make_source_lines(bytes, seed)) ||
+        !write_file(config.dir + "/adversarial.txt", make_adversarial_lines(bytes / 8, seed)) ||
+        !write_file(config.dir + "/address.txt", make_address_lines(bytes, seed)) ||
+        !write_tree(config.dir + "/tree", config.files, 32 << 10, seed))
+    {
+        std::fprintf(stderr, "failed to write corpus under %s\n", config.dir.c_str());
+        return 1;
+    }
+
+    bench_compile(config);
+    bench_match(config);
+    bench_static(config);
+    bench_scan(config);
+    bench_multi(config);
+    bench_linear(config);
+    if (!config.exe.empty())
+    {
+        bench_cli(config);
+        bench_startup(config);
+    }
+    return 0;
+}
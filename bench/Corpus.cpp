@@ -0,0 +1,159 @@
+#include "Corpus.h"
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace fs = std::filesystem;
+
+static const char *const levels[] = {"INFO", "INFO", "INFO", "DEBUG", "WARN"};
+static const char *const methods[] = {"GET", "GET", "POST", "PUT", "DELETE"};
+static const char *const resources[] = {"users", "orders", "items", "sessions", "health"};
+static const char *const words[] = {"auto", "const", "return", "std::vector<int>", "std::map<std::string, int>",
+                                    "if", "for", "while", "size_t", "nullptr", "value", "index", "result",
+                                    "buffer", "count", "// TODO: tidy up", "template", "struct", "begin()", "end()"};
+
+template <size_t N>
+static const char *pick(std::mt19937_64 &rng, const char *const (&list)[N])
+{
+    return list[rng() % N];
+}
+
+std::string make_log_lines(size_t bytes, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::string out;
+    out.reserve(bytes + 256);
+    char line[256];
+    while (out.size() < bytes)
+    {
+        bool error = rng() % 100 == 0;
+        unsigned status = error ? 500 + rng() % 4 : (rng() % 10 == 0 ? 404 : 200);
+        int n = snprintf(line, sizeof(line),
+                         "2024-01-%02u %02u:%02u:%02u.%03u %s [worker-%u] %s /api/v%u/%s/%u status=%u latency_ms=%u id=%08x\n",
+                         static_cast<unsigned>(1 + rng() % 28), static_cast<unsigned>(rng() % 24),
+                         static_cast<unsigned>(rng() % 60), static_cast<unsigned>(rng() % 60),
+                         static_cast<unsigned>(rng() % 1000), error ? "ERROR" : pick(rng, levels),
+                         static_cast<unsigned>(rng() % 64), pick(rng, methods), static_cast<unsigned>(1 + rng() % 3),
+                         pick(rng, resources), static_cast<unsigned>(rng() % 100000), status,
+                         static_cast<unsigned>(rng() % 2000), static_cast<unsigned>(rng()));
+        out.append(line, static_cast<size_t>(n));
+    }
+    return out;
+}
+
+std::string make_address_lines(size_t bytes, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::string out;
+    out.reserve(bytes + 256);
+    char line[256];
+    while (out.size() < bytes)
+    {
+        auto octet = [&]
+        { return static_cast<unsigned>(rng() % (rng() % 2 ? 256 : 10)); };
+        int n;
+        if (rng() % 4 == 0)
+            n = snprintf(line, sizeof(line), "%s src=%u.%u.%u.%u dst=%u.%u.%u.%u dport=%u\n", pick(rng, methods), octet(),
+                         octet(), octet(), octet(), octet(), octet(), octet(), octet(),
+                         static_cast<unsigned>(rng() % 65536));
+        else
+            n = snprintf(line, sizeof(line), "%s build=%u.%u.%u agent=v%u.%u dport=%u latency_ms=%u.%03u\n",
+                         pick(rng, levels), octet(), octet(), octet(), octet(), octet(),
+                         static_cast<unsigned>(rng() % 65536), static_cast<unsigned>(rng() % 2000),
+                         static_cast<unsigned>(rng() % 1000));
+        out.append(line, static_cast<size_t>(n));
+    }
+    return out;
+}
+
+std::vector<std::string> make_ioc_patterns(size_t count, uint64_t seed)
+{
+    std::mt19937_64 rng(seed ^ 0x10c);
+    std::vector<std::string> patterns;
+    char id[32];
+    for (size_t i = 0; i < count; ++i)
+    {
+        snprintf(id, sizeof(id), "id=%08x", static_cast<unsigned>(rng()));
+        patterns.push_back(id);
+    }
+    return patterns;
+}
+
+std::vector<std::string> make_route_patterns(size_t count, uint64_t seed)
+{
+    std::mt19937_64 rng(seed ^ 0x4057e);
+    std::vector<std::string> patterns;
+    char rule[128];
+    for (size_t i = 0; i < count; ++i)
+    {
+        snprintf(rule, sizeof(rule), "(%s|%s) /api/v%u/%s/[0-9]{%u,%u} status=%u", pick(rng, methods), pick(rng, methods),
+                 static_cast<unsigned>(1 + rng() % 3), pick(rng, resources), static_cast<unsigned>(1 + rng() % 2),
+                 static_cast<unsigned>(3 + rng() % 3), static_cast<unsigned>(2 + rng() % 4));
+        patterns.push_back(rule);
+    }
+    return patterns;
+}
+
+std::string make_source_lines(size_t bytes, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::string out;
+    out.reserve(bytes + 256);
+    while (out.size() < bytes)
+    {
+        out.append(rng() % 4 * 4, ' ');
+        size_t count = 1 + rng() % 8;
+        for (size_t i = 0; i < count; ++i)
+        {
+            out += pick(rng, words);
+            out += (rng() % 5 == 0) ? "(" : " ";
+        }
+        out += ";\n";
+    }
+    return out;
+}
+
+std::string make_adversarial_lines(size_t bytes, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::string out;
+    out.reserve(bytes + 4096);
+    while (out.size() < bytes)
+    {
+        out.append(64 + rng() % 4000, 'a');
+        out += '\n';
+    }
+    return out;
+}
+
+bool write_file(const std::string &path, const std::string &data)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(file);
+}
+
+bool write_tree(const std::string &root, size_t files, size_t bytes_per_file, uint64_t seed)
+{
+    std::error_code ec;
+    fs::remove_all(root, ec);
+    for (size_t i = 0; i < files; ++i)
+    {
+        // names are appended piecewise: "d" + std::to_string() trips a false
+        // -Wrestrict in GCC 12's std::string
+        fs::path dir = fs::path(root) / "d";
+        dir += std::to_string(i % 32);
+        dir /= "s";
+        dir += std::to_string(i % 7);
+        fs::create_directories(dir, ec);
+        bool is_log = i % 3 == 0;
+        std::string data = is_log ? make_log_lines(bytes_per_file, seed + i) : make_source_lines(bytes_per_file, seed + i);
+        fs::path file = dir / "f";
+        file += std::to_string(i);
+        file += is_log ? ".log" : ".cpp";
+        if (!write_file(file.string(), data))
+            return false;
+    }
+    return true;
+}
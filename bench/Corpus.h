@@ -0,0 +1,38 @@
+#ifndef CORPUS
+#define CORPUS
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Deterministic benchmark inputs: the same seed always yields the same bytes,
+// so numbers from different builds and machines stay comparable.
+
+// web-service style log lines, roughly 1% ERROR
+std::string make_log_lines(size_t bytes, uint64_t seed);
+
+// C++-looking source code
+std::string make_source_lines(size_t bytes, uint64_t seed);
+
+// long runs of 'a' that make backtracking engines explode on (a+)+b
+std::string make_adversarial_lines(size_t bytes, uint64_t seed);
+
+// firewall-style lines with dotted quads and near misses (versions, short
+// dotted runs) for counted repetitions such as \d{1,3}(\.\d{1,3}){3}
+std::string make_address_lines(size_t bytes, uint64_t seed);
+
+// `count` indicator-of-compromise style literals ("id=" + 8 hex digits); being
+// random they are almost never in the log corpus, the usual case for such lists
+std::vector<std::string> make_ioc_patterns(size_t count, uint64_t seed);
+
+// `count` routing-rule style regexes for the log corpus, e.g.
+// "(GET|POST) /api/v2/orders/[0-9]{2,5} status=5"
+std::vector<std::string> make_route_patterns(size_t count, uint64_t seed);
+
+// a directory tree of `files` mixed log/source files under root
+bool write_tree(const std::string &root, size_t files, size_t bytes_per_file, uint64_t seed);
+
+bool write_file(const std::string &path, const std::string &data);
+
+#endif
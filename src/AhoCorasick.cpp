@@ -0,0 +1,92 @@
+#include "include/AhoCorasick.h"
+
+#include <cstring>
+
+AhoCorasick::AhoCorasick(const std::vector<std::string> &literals)
+{
+    // bytes that occur in no literal share column 0
+    std::memset(_classes, 0, sizeof(_classes));
+    for (const auto &literal : literals)
+    {
+        for (unsigned char c : literal)
+        {
+            if (_classes[c] == 0)
+                _classes[c] = static_cast<uint8_t>(_class_count++);
+        }
+    }
+
+    // trie; -1 marks a missing edge until the failure links fill it in
+    add_state();
+    for (const auto &literal : literals)
+    {
+        int32_t state = 0;
+        for (unsigned char c : literal)
+        {
+            int32_t &edge = _next[state * _class_count + _classes[c]];
+            if (edge < 0)
+            {
+                int32_t child = add_state();
+                _next[state * _class_count + _classes[c]] = child;
+                state = child;
+            }
+            else
+                state = edge;
+        }
+        _accept[state] = 1;
+    }
+
+    // breadth first, so the failure target of a state is complete before its children
+    std::vector<int32_t> fail(state_count(), 0);
+    std::vector<int32_t> queue;
+    for (size_t cls = 0; cls < _class_count; ++cls)
+    {
+        int32_t &edge = _next[cls];
+        if (edge < 0)
+            edge = 0;
+        else
+            queue.push_back(edge);
+    }
+    for (size_t head = 0; head < queue.size(); ++head)
+    {
+        int32_t state = queue[head];
+        _accept[state] |= _accept[fail[state]];
+        for (size_t cls = 0; cls < _class_count; ++cls)
+        {
+            int32_t &edge = _next[state * _class_count + cls];
+            int32_t fallback = _next[fail[state] * _class_count + cls];
+            if (edge < 0)
+                edge = fallback;
+            else
+            {
+                fail[edge] = fallback;
+                queue.push_back(edge);
+            }
+        }
+    }
+
+    for (auto &edge : _next)
+        edge = static_cast<int32_t>(edge * _class_count) << 1 | _accept[edge];
+}
+
+int32_t AhoCorasick::add_state()
+{
+    _next.resize(_next.size() + _class_count, -1);
+    _accept.push_back(0);
+    return static_cast<int32_t>(_accept.size()) - 1;
+}
+
+const char *AhoCorasick::find(const char *begin, const char *end) const
+{
+    if (_accept[0])
+        return begin < end ? begin : nullptr;
+
+    const int32_t *next = _next.data();
+    int32_t edge = 0;
+    for (const char *p = begin; p < end; ++p)
+    {
+        edge = next[(edge >> 1) + _classes[static_cast<unsigned char>(*p)]];
+        if (edge & 1)
+            return p;
+    }
+    return nullptr;
+}
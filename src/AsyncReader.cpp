@@ -0,0 +1,398 @@
+#include "include/AsyncReader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// liburing is not required: the few calls needed are made directly
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define HAVE_IO_URING 1
+#endif
+
+#ifdef HAVE_IO_URING
+struct AsyncReader::Ring
+{
+    int fd = -1;
+    void *sq_map = MAP_FAILED;
+    void *cq_map = MAP_FAILED;
+    size_t sq_map_size = 0;
+    size_t cq_map_size = 0;
+    io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+    size_t sqes_size = 0;
+    unsigned *sq_tail = nullptr;
+    unsigned *sq_mask = nullptr;
+    unsigned *sq_array = nullptr;
+    unsigned *cq_head = nullptr;
+    unsigned *cq_tail = nullptr;
+    unsigned *cq_mask = nullptr;
+    io_uring_cqe *cqes = nullptr;
+    unsigned to_submit = 0;
+
+    ~Ring()
+    {
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqes_size);
+        if (cq_map != MAP_FAILED && cq_map != sq_map)
+            munmap(cq_map, cq_map_size);
+        if (sq_map != MAP_FAILED)
+            munmap(sq_map, sq_map_size);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    // false when the kernel has no io_uring, refuses it, or lacks openat and read on it
+    bool init(unsigned entries)
+    {
+        io_uring_params params{};
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0)
+            return false;
+
+        sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_map = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_map)
+            sq_map_size = cq_map_size = std::max(sq_map_size, cq_map_size);
+        sq_map = mmap(nullptr, sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sq_map == MAP_FAILED)
+            return false;
+        cq_map = single_map ? sq_map
+                            : mmap(nullptr, cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                   IORING_OFF_CQ_RING);
+        if (cq_map == MAP_FAILED)
+            return false;
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe *>(
+            mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED)
+            return false;
+
+        char *sq = static_cast<char *>(sq_map);
+        sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        char *cq = static_cast<char *>(cq_map);
+        cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        return supports(IORING_OP_OPENAT) && supports(IORING_OP_READ);
+    }
+
+    bool supports(unsigned op) const
+    {
+        std::vector<char> buffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+        auto *probe = reinterpret_cast<io_uring_probe *>(buffer.data());
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) < 0)
+            return false;
+        return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    // the caller never has more entries queued than the ring holds
+    void push(const io_uring_sqe &entry)
+    {
+        unsigned tail = *sq_tail;
+        unsigned index = tail & *sq_mask;
+        sqes[index] = entry;
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        ++to_submit;
+    }
+
+    void open(uint64_t slot, const std::string &path)
+    {
+        io_uring_sqe entry{};
+        entry.opcode = IORING_OP_OPENAT;
+        entry.fd = AT_FDCWD;
+        entry.addr = reinterpret_cast<uint64_t>(path.c_str());
+        entry.open_flags = O_RDONLY | O_CLOEXEC;
+        entry.user_data = slot;
+        push(entry);
+    }
+
+    void read(uint64_t slot, int file, char *data, size_t size, size_t offset)
+    {
+        io_uring_sqe entry{};
+        entry.opcode = IORING_OP_READ;
+        entry.fd = file;
+        entry.addr = reinterpret_cast<uint64_t>(data);
+        entry.len = static_cast<uint32_t>(size);
+        entry.off = offset;
+        entry.user_data = slot;
+        push(entry);
+    }
+
+    // submits what was pushed and waits for at least one completion
+    void submit_and_wait()
+    {
+        while (true)
+        {
+            long n = syscall(__NR_io_uring_enter, fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (n >= 0)
+            {
+                to_submit -= static_cast<unsigned>(n);
+                return;
+            }
+            // buffers stay owned by the kernel until their completions arrive,
+            // so there is no safe way to carry on without the ring
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            {
+                std::cerr << "io_uring_enter failed: " << strerror(errno) << std::endl;
+                std::abort();
+            }
+        }
+    }
+
+    bool pop(io_uring_cqe &completion)
+    {
+        unsigned head = *cq_head;
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+            return false;
+        completion = cqes[head & *cq_mask];
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+};
+#else
+struct AsyncReader::Ring
+{
+    bool init(unsigned) { return false; }
+};
+#endif
+
+AsyncReader::AsyncReader(IoBackend backend, Deliver deliver) : _deliver(std::move(deliver))
+{
+    if (backend != IO_PREAD)
+    {
+        auto ring = std::make_unique<Ring>();
+        if (ring->init(queue_depth))
+            _ring = std::move(ring);
+        else if (backend == IO_URING)
+            std::cerr << "io_uring is not available, reading with pread threads" << std::endl;
+    }
+
+    if (_ring)
+        _threads.emplace_back(&AsyncReader::run_ring, this);
+    else
+    {
+        for (size_t i = 0; i < io_threads; ++i)
+            _threads.emplace_back(&AsyncReader::run_pread, this);
+    }
+}
+
+AsyncReader::~AsyncReader()
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _stopping = true;
+    }
+    _work.notify_all();
+    for (auto &thread : _threads)
+        thread.join();
+}
+
+const char *AsyncReader::backend() const
+{
+    return _ring ? "io_uring" : "pread";
+}
+
+void AsyncReader::submit(size_t sequence, std::string path)
+{
+    std::unique_lock<std::mutex> guard(_lock);
+    _space.wait(guard, [this] { return _outstanding < max_outstanding; });
+    ReadFile file;
+    file.sequence = sequence;
+    file.path = std::move(path);
+    _queue.push_back(std::move(file));
+    ++_outstanding;
+    ++_undelivered;
+    guard.unlock();
+    _work.notify_one();
+}
+
+void AsyncReader::release()
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        --_outstanding;
+    }
+    _space.notify_one();
+}
+
+void AsyncReader::drain()
+{
+    std::unique_lock<std::mutex> guard(_lock);
+    _drained.wait(guard, [this] { return _undelivered == 0; });
+}
+
+bool AsyncReader::next(ReadFile &file, bool block)
+{
+    std::unique_lock<std::mutex> guard(_lock);
+    if (block)
+        _work.wait(guard, [this] { return !_queue.empty() || _stopping; });
+    if (_queue.empty())
+        return false;
+    file = std::move(_queue.front());
+    _queue.pop_front();
+    return true;
+}
+
+void AsyncReader::delivered(ReadFile &&file)
+{
+    _deliver(std::move(file));
+    bool drained;
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        drained = --_undelivered == 0;
+    }
+    if (drained)
+        _drained.notify_all();
+}
+
+// leaves file.fd open when the file is not a regular one or too large to read whole
+void AsyncReader::read_whole(ReadFile &file)
+{
+    file.fd = open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file.fd < 0)
+    {
+        file.error = errno;
+        return;
+    }
+    struct stat st;
+    if (fstat(file.fd, &st) != 0 || !S_ISREG(st.st_mode) || static_cast<size_t>(st.st_size) > whole_file_limit)
+        return;
+
+    file.data.resize(static_cast<size_t>(st.st_size));
+    size_t filled = 0;
+    while (filled < file.data.size())
+    {
+        ssize_t n = pread(file.fd, file.data.data() + filled, file.data.size() - filled, static_cast<off_t>(filled));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        filled += static_cast<size_t>(n);
+    }
+    file.data.resize(filled);
+    close(file.fd);
+    file.fd = -1;
+}
+
+void AsyncReader::run_pread()
+{
+    ReadFile file;
+    while (next(file, true))
+    {
+        read_whole(file);
+        delivered(std::move(file));
+        file = ReadFile();
+    }
+}
+
+#ifdef HAVE_IO_URING
+// Every slot holds one file and has at most one request in flight: first
+// its openat, then reads until the file is complete. Descriptors are
+// checked with fstat and closed synchronously; both are cheap next to the
+// opens and reads that wait for the disk.
+void AsyncReader::run_ring()
+{
+    struct Slot
+    {
+        ReadFile file;
+        size_t filled = 0;
+    };
+    std::vector<Slot> slots(queue_depth);
+    std::vector<size_t> free_slots;
+    for (size_t i = queue_depth; i-- > 0;)
+        free_slots.push_back(i);
+    size_t in_flight = 0;
+
+    while (true)
+    {
+        // start opens for queued files while slots are free; wait for files
+        // only when nothing is in flight
+        ReadFile file;
+        while (!free_slots.empty() && next(file, in_flight == 0))
+        {
+            size_t i = free_slots.back();
+            free_slots.pop_back();
+            slots[i] = {std::move(file), 0};
+            _ring->open(i, slots[i].file.path);
+            ++in_flight;
+            file = ReadFile();
+        }
+        if (in_flight == 0)
+            break;
+
+        _ring->submit_and_wait();
+        io_uring_cqe completion;
+        while (_ring->pop(completion))
+        {
+            size_t i = static_cast<size_t>(completion.user_data);
+            Slot &slot = slots[i];
+            ReadFile &current = slot.file;
+            bool finished = true;
+            if (current.fd < 0)
+            {
+                if (completion.res < 0)
+                    read_whole(current); // reports the error, or works where the ring would not
+                else
+                {
+                    current.fd = completion.res;
+                    struct stat st;
+                    bool whole = fstat(current.fd, &st) == 0 && S_ISREG(st.st_mode) &&
+                                 static_cast<size_t>(st.st_size) <= whole_file_limit;
+                    if (whole && st.st_size > 0)
+                    {
+                        current.data.resize(static_cast<size_t>(st.st_size));
+                        _ring->read(i, current.fd, current.data.data(), current.data.size(), 0);
+                        finished = false;
+                    }
+                    else if (whole)
+                    {
+                        close(current.fd);
+                        current.fd = -1;
+                    }
+                }
+            }
+            else
+            {
+                if (completion.res > 0)
+                    slot.filled += static_cast<size_t>(completion.res);
+                // a short read is only the end of the file when it returned
+                // nothing; like scan_fd(), a failed read keeps what was read
+                finished = completion.res <= 0 || slot.filled == current.data.size();
+                if (finished)
+                {
+                    current.data.resize(slot.filled);
+                    close(current.fd);
+                    current.fd = -1;
+                }
+                else
+                    _ring->read(i, current.fd, current.data.data() + slot.filled, current.data.size() - slot.filled,
+                                slot.filled);
+            }
+
+            if (finished)
+            {
+                --in_flight;
+                free_slots.push_back(i);
+                delivered(std::move(current));
+                slot = Slot();
+            }
+        }
+    }
+}
+#else
+void AsyncReader::run_ring()
+{
+}
+#endif
@@ -0,0 +1,165 @@
+#include "include/Backtracker.h"
+
+#include <algorithm>
+#include <cstring>
+
+static constexpr size_t npos = std::string_view::npos;
+
+Backtracker::Backtracker(Nfa nfa) : _nfa(std::move(nfa))
+{
+    _slots.assign(static_cast<size_t>(_nfa.slot_count), npos);
+    collect_first();
+}
+
+// Walks the epsilon edges from the start state. A ^ can only pass at the
+// start of the text; anything else other than a byte (a $, a backreference or
+// the match itself) may begin a match without knowing the next byte, so the
+// attempt has to run everywhere.
+void Backtracker::collect_first()
+{
+    std::vector<bool> seen(_nfa.states.size());
+    std::vector<int> pending{_nfa.start};
+    while (!pending.empty())
+    {
+        int id = pending.back();
+        pending.pop_back();
+        if (id < 0 || seen[id])
+            continue;
+        seen[id] = true;
+        const NfaState &st = _nfa.states[id];
+        switch (st.op)
+        {
+        case NFA_BYTE:
+            _first.merge(_nfa.sets[st.set]);
+            break;
+        case NFA_SPLIT:
+        case NFA_PROGRESS:
+            pending.push_back(st.out);
+            pending.push_back(st.out1);
+            break;
+        case NFA_SAVE:
+            pending.push_back(st.out);
+            break;
+        case NFA_BOL:
+            _bol_start = true;
+            break;
+        default:
+            _empty_start = true;
+            break;
+        }
+    }
+    _anchored = _bol_start && !_empty_start && _first.count() == 0;
+}
+
+// The clock is read every this many steps; a step costs a few nanoseconds,
+// so a deadline is overrun by well under a millisecond.
+static constexpr uint64_t clock_interval = 1 << 16;
+
+bool Backtracker::search(std::string_view text, size_t start, std::vector<size_t> &slots)
+{
+    // once the deadline has passed every later search gives up at once
+    _gave_up = _expired;
+    _step_limit = _limits.max_steps > 0 ? _steps + _limits.max_steps : UINT64_MAX;
+    _next_check = std::min(_step_limit, _clock_at);
+    for (size_t pos = start; pos <= text.size() && !_gave_up; ++pos)
+    {
+        if (pos > 0 && _anchored)
+            break;
+        if (!_empty_start && !(pos == 0 && _bol_start) &&
+            (pos == text.size() || !_first.test(static_cast<unsigned char>(text[pos]))))
+        {
+            continue;
+        }
+        std::fill(_slots.begin(), _slots.end(), npos);
+        if (run(text, pos))
+        {
+            slots = _slots;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Follows the preferred edge of every SPLIT first and resumes from the most
+// recent alternative when a path fails.
+bool Backtracker::run(std::string_view text, size_t pos)
+{
+    _stack.clear();
+    _stack.push_back({_nfa.start, pos, -1, 0});
+    while (!_stack.empty())
+    {
+        Frame frame = _stack.back();
+        _stack.pop_back();
+        if (frame.slot >= 0)
+        {
+            _slots[frame.slot] = frame.value;
+            continue;
+        }
+
+        int id = frame.id;
+        pos = frame.pos;
+        while (id >= 0)
+        {
+            if (++_steps >= _next_check && out_of_budget())
+                return false;
+            const NfaState &st = _nfa.states[id];
+            switch (st.op)
+            {
+            case NFA_BYTE:
+                id = pos < text.size() && _nfa.sets[st.set].test(static_cast<unsigned char>(text[pos])) ? st.out : -1;
+                ++pos;
+                break;
+            case NFA_SPLIT:
+                _stack.push_back({st.out1, pos, -1, 0});
+                id = st.out;
+                break;
+            case NFA_BOL:
+                id = pos == 0 ? st.out : -1;
+                break;
+            case NFA_EOL:
+                id = pos == text.size() ? st.out : -1;
+                break;
+            case NFA_SAVE:
+                _stack.push_back({-1, 0, st.slot, _slots[st.slot]});
+                _slots[st.slot] = pos;
+                id = st.out;
+                break;
+            case NFA_PROGRESS:
+                id = _slots[st.slot] != pos ? st.out : st.out1;
+                break;
+            case NFA_BACKREF:
+            {
+                // a group that did not take part matches nothing, as in GNU grep
+                size_t begin = _slots[2 * st.slot];
+                size_t end = _slots[2 * st.slot + 1];
+                if (begin == npos || end == npos || end - begin > text.size() - pos ||
+                    memcmp(text.data() + begin, text.data() + pos, end - begin) != 0)
+                {
+                    id = -1;
+                    break;
+                }
+                pos += end - begin;
+                id = st.out;
+                break;
+            }
+            case NFA_MATCH:
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool Backtracker::out_of_budget()
+{
+    if (_steps >= _clock_at)
+    {
+        // counted across searches, so many short lines read the clock as rarely as one long one
+        _clock_at = _steps + clock_interval;
+        _expired = _limits.deadline != std::chrono::steady_clock::time_point::max() &&
+                   std::chrono::steady_clock::now() >= _limits.deadline;
+    }
+    _gave_up = _expired || _steps >= _step_limit;
+    _next_check = std::min(_step_limit, _clock_at);
+    return _gave_up;
+}
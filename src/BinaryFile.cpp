@@ -0,0 +1,25 @@
+#include "include/BinaryFile.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+bool replace_file(const std::string &path, const std::string &contents)
+{
+    std::string temporary = path + ".tmp." + std::to_string(getpid());
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+    size_t written = 0;
+    while (written < contents.size())
+    {
+        ssize_t n = write(fd, contents.data() + written, contents.size() - written);
+        if (n <= 0)
+            break;
+        written += static_cast<size_t>(n);
+    }
+    bool ok = close(fd) == 0 && written == contents.size() && rename(temporary.c_str(), path.c_str()) == 0;
+    if (!ok)
+        unlink(temporary.c_str());
+    return ok;
+}
@@ -0,0 +1,99 @@
+#include "include/DirWalker.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+static bool any_glob(const std::vector<std::string> &globs, std::string_view name)
+{
+    return std::any_of(globs.begin(), globs.end(), [name](const std::string &glob)
+                       { return glob_match(glob, name); });
+}
+
+DirWalker::DirWalker(const Options &opts)
+    : _hidden(opts.hidden), _ignore_files(!opts.no_ignore), _include(opts.include), _exclude(opts.exclude),
+      _exclude_dir(opts.exclude_dir)
+{
+}
+
+void DirWalker::walk(const std::string &root, bool sorted, const std::function<void(std::string)> &visit,
+                     const std::atomic<bool> *cancel)
+{
+    _levels.clear();
+    walk_dir(root, sorted, visit, cancel);
+}
+
+void DirWalker::walk_dir(const std::string &dir, bool sorted, const std::function<void(std::string)> &visit,
+                         const std::atomic<bool> *cancel)
+{
+    std::string base = dir;
+    if (base.empty() || base.back() != '/')
+        base += '/';
+
+    // .ignore comes last so that its rules win over those of .gitignore
+    bool has_rules = false;
+    if (_ignore_files)
+    {
+        Level level{base.size(), {}};
+        level.rules.load(base + ".gitignore");
+        level.rules.load(base + ".ignore");
+        if (!level.rules.empty())
+        {
+            _levels.push_back(std::move(level));
+            has_rules = true;
+        }
+    }
+
+    // the entry types come from the directory listing itself, so nothing is
+    // stat'ed except symbolic links
+    std::vector<fs::directory_entry> entries;
+    std::error_code ec;
+    for (fs::directory_iterator it(dir, fs::directory_options::skip_permission_denied, ec), end; !ec && it != end;
+         it.increment(ec))
+    {
+        entries.push_back(*it);
+    }
+    if (ec)
+        std::cerr << "Failed to read directory: " << dir << ": " << ec.message() << std::endl;
+    if (sorted)
+        std::sort(entries.begin(), entries.end(), [](const fs::directory_entry &a, const fs::directory_entry &b)
+                  { return a.path().filename().native() < b.path().filename().native(); });
+
+    for (const auto &entry : entries)
+    {
+        if (cancel && cancel->load(std::memory_order_relaxed))
+            break;
+        std::string name = entry.path().filename().string();
+        if (!_hidden && name[0] == '.')
+            continue;
+        std::string path = base + name;
+        if (entry.is_directory(ec) && !entry.is_symlink(ec))
+        {
+            if (!any_glob(_exclude_dir, name) && !ignored(path, true))
+                walk_dir(path, sorted, visit, cancel);
+        }
+        else if (entry.is_regular_file(ec) && selected(name) && !ignored(path, false))
+            visit(std::move(path));
+    }
+
+    if (has_rules)
+        _levels.pop_back();
+}
+
+bool DirWalker::ignored(const std::string &path, bool is_dir) const
+{
+    for (auto it = _levels.rbegin(); it != _levels.rend(); ++it)
+    {
+        IgnoreMatch match = it->rules.match(std::string_view(path).substr(it->prefix), is_dir);
+        if (match != IGNORE_NONE)
+            return match == IGNORE_SKIP;
+    }
+    return false;
+}
+
+bool DirWalker::selected(std::string_view name) const
+{
+    return !any_glob(_exclude, name) && (_include.empty() || any_glob(_include, name));
+}
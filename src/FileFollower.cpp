@@ -0,0 +1,238 @@
+#include "include/FileFollower.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// where following the first size bytes of fd starts: at their end, or at the
+// start of their last line when that lacks its newline, so that a line still
+// being written is matched whole once it is complete
+static off_t follow_start(int fd, off_t size)
+{
+    char block[4096];
+    off_t end = size;
+    while (end > 0)
+    {
+        off_t begin = end > static_cast<off_t>(sizeof(block)) ? end - static_cast<off_t>(sizeof(block)) : 0;
+        ssize_t n = pread(fd, block, static_cast<size_t>(end - begin), begin);
+        if (n <= 0)
+            return size;
+        const char *newline = static_cast<const char *>(memrchr(block, '\n', static_cast<size_t>(n)));
+        if (newline)
+            return begin + (newline - block) + 1;
+        end = begin;
+    }
+    return 0;
+}
+
+// newlines in the first size bytes of fd, for -n to number the lines after
+// them as the file does
+static size_t count_lines(int fd, off_t size)
+{
+    std::vector<char> block(1 << 16);
+    size_t lines = 0;
+    off_t begin = 0;
+    while (begin < size)
+    {
+        size_t want = static_cast<size_t>(std::min<off_t>(size - begin, static_cast<off_t>(block.size())));
+        ssize_t n = pread(fd, block.data(), want, begin);
+        if (n <= 0)
+            break;
+        lines += static_cast<size_t>(std::count(block.data(), block.data() + n, '\n'));
+        begin += n;
+    }
+    return lines;
+}
+
+FileFollower::FileFollower(const Options &opts, PatternSet &pattern, OutputSink &sink) : _opts(opts), _sink(sink)
+{
+    _inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    for (const auto &path : opts.paths)
+    {
+        Followed file;
+        file.path = path;
+        if (opts.paths.size() > 1)
+            file.label = path;
+        file.scanner = std::make_unique<FileScanner>(pattern, &sink);
+        file.scanner->set_line_numbers(opts.line_numbers);
+        file.scanner->set_mode(opts.mode);
+        if (opts.context)
+            file.scanner->set_context(opts.after_context, opts.before_context);
+        file.scanner->set_max_count(opts.max_count);
+        file.scanner->set_limits(opts.max_steps, opts.timeout);
+        _files.push_back(std::move(file));
+    }
+}
+
+FileFollower::~FileFollower()
+{
+    for (auto &file : _files)
+        close_file(file);
+    if (_inotify >= 0)
+        close(_inotify);
+}
+
+bool FileFollower::run()
+{
+    for (auto &file : _files)
+    {
+        if (_inotify >= 0)
+        {
+            // creation, renames and deletion of the file show up in its directory
+            size_t slash = file.path.rfind('/');
+            std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : file.path.substr(0, slash);
+            if (inotify_add_watch(_inotify, dir.c_str(), IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0)
+            {
+                // without it a rotation would go unnoticed until the next write
+                close(_inotify);
+                _inotify = -1;
+            }
+        }
+        if (!open_file(file, true))
+            std::cerr << "Failed to open file: " << file.path << " (waiting for it)" << std::endl;
+    }
+
+    while (!finished())
+    {
+        wait();
+        for (auto &file : _files)
+            check(file);
+        _sink.flush();
+    }
+
+    for (const auto &file : _files)
+    {
+        if (file.matched)
+            return true;
+    }
+    return false;
+}
+
+bool FileFollower::open_file(Followed &file, bool at_end)
+{
+    int fd = open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    off_t start = at_end && S_ISREG(st.st_mode) ? follow_start(fd, st.st_size) : 0;
+    if (start > 0)
+        lseek(fd, start, SEEK_SET);
+
+    file.fd = fd;
+    file.dev = st.st_dev;
+    file.ino = st.st_ino;
+    file.scanner->restart_stream();
+    // only -n needs the lines skipped; reading them all is not free
+    if (start > 0 && _opts.line_numbers)
+        file.scanner->skip_lines(count_lines(fd, start));
+    if (_inotify >= 0)
+    {
+        // watching the open file rather than its path keeps reporting writes
+        // after it was renamed away
+        std::string self = "/proc/self/fd/" + std::to_string(fd);
+        file.wd = inotify_add_watch(_inotify, self.c_str(), IN_MODIFY);
+        if (file.wd < 0)
+            file.wd = inotify_add_watch(_inotify, file.path.c_str(), IN_MODIFY);
+    }
+    return true;
+}
+
+void FileFollower::close_file(Followed &file)
+{
+    if (file.fd < 0)
+        return;
+    close(file.fd);
+    file.fd = -1;
+
+    // a file followed under two names shares its watch
+    bool shared = false;
+    for (const auto &other : _files)
+        shared |= &other != &file && other.fd >= 0 && other.wd == file.wd;
+    if (_inotify >= 0 && file.wd >= 0 && !shared)
+        inotify_rm_watch(_inotify, file.wd);
+    file.wd = -1;
+}
+
+void FileFollower::check(Followed &file)
+{
+    if (file.fd < 0)
+    {
+        // created since the last check: all of it is new
+        if (open_file(file, false))
+            read_appended(file);
+        return;
+    }
+
+    // the old file first: its writer may have added lines before the rotation
+    read_appended(file);
+
+    struct stat st;
+    if (stat(file.path.c_str(), &st) == 0 && (st.st_dev != file.dev || st.st_ino != file.ino))
+    {
+        file.matched |= file.scanner->finish_stream(file.label);
+        close_file(file);
+        if (open_file(file, false))
+            read_appended(file);
+    }
+}
+
+void FileFollower::read_appended(Followed &file)
+{
+    struct stat st;
+    off_t read_to = lseek(file.fd, 0, SEEK_CUR);
+    if (fstat(file.fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size < read_to)
+    {
+        std::cerr << file.path << ": file truncated" << std::endl;
+        lseek(file.fd, 0, SEEK_SET);
+        file.scanner->restart_stream();
+    }
+
+    // --timeout bounds each batch of appended lines
+    FileScanner &scanner = *file.scanner;
+    scanner.start_file(std::chrono::steady_clock::now());
+    file.matched |= scanner.scan_appended(file.fd, file.label);
+    FileScanner::report_limits(file.path, scanner.abandoned(), scanner.timed_out(), _opts.timeout);
+}
+
+void FileFollower::wait()
+{
+    if (_inotify < 0)
+    {
+        poll(nullptr, 0, poll_interval);
+        return;
+    }
+
+    struct pollfd fd = {_inotify, POLLIN, 0};
+    if (poll(&fd, 1, -1) <= 0)
+        return;
+
+    // which file changed does not matter: every wake-up checks them all
+    alignas(struct inotify_event) char events[4096];
+    while (read(_inotify, events, sizeof(events)) > 0)
+    {
+    }
+}
+
+bool FileFollower::finished() const
+{
+    bool any_matched = false;
+    bool all_done = true;
+    for (const auto &file : _files)
+    {
+        any_matched |= file.matched;
+        all_done &= file.scanner->matched() >= _opts.max_count;
+    }
+    return _opts.mode == PRINT_NOTHING ? any_matched : all_done;
+}
@@ -0,0 +1,382 @@
+#include "include/FileScanner.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool FileScanner::scan_fd(int fd, const std::string &label, const std::string &name)
+{
+    auto started = begin_file();
+    if (!done())
+    {
+        struct stat st;
+        bool found = false;
+        if (!(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+              scan_mapped(fd, static_cast<size_t>(st.st_size), label, found)))
+        {
+            // pipes, terminals, procfs files and anything mmap refuses
+            scan_stream(fd, label);
+        }
+    }
+    return end_file(started, label, name);
+}
+
+bool FileScanner::scan_data(const char *data, size_t size, const std::string &label, const std::string &name)
+{
+    auto started = begin_file();
+    _history = data;
+    if (!done() && !is_binary(data, size))
+        scan_buffer(data, data + size, label);
+    return end_file(started, label, name);
+}
+
+std::chrono::steady_clock::time_point FileScanner::begin_file()
+{
+    auto started = std::chrono::steady_clock::now();
+    reset_counts();
+    start_file(started);
+    _history = nullptr;
+    _printed_end = nullptr;
+    _after_left = 0;
+    _binary = false;
+    return started;
+}
+
+bool FileScanner::end_file(std::chrono::steady_clock::time_point started, const std::string &label,
+                           const std::string &name)
+{
+    const std::string &shown = name.empty() ? (label.empty() ? std::string("(standard input)") : label) : name;
+    switch (_binary ? PRINT_NOTHING : _mode)
+    {
+    case PRINT_COUNT:
+        emit_summary(label.empty() ? std::to_string(_matched) : label + ":" + std::to_string(_matched));
+        break;
+    case PRINT_MATCHING:
+        if (_matched > 0)
+            emit_summary(shown);
+        break;
+    case PRINT_NON_MATCHING:
+        if (_matched == 0)
+            emit_summary(shown);
+        break;
+    default:
+        break;
+    }
+
+    if (_stats)
+    {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        _stats->files.push_back({shown, _bytes, _lines, _matched, elapsed.count()});
+    }
+    report_limits(shown, abandoned(), timed_out(), _timeout);
+    return _matched > 0;
+}
+
+void FileScanner::start_file(std::chrono::steady_clock::time_point started)
+{
+    MatchLimits limits;
+    limits.max_steps = _max_steps;
+    if (_timeout > 0)
+        limits.deadline = started + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                        std::chrono::duration<double>(_timeout));
+    _pattern.set_limits(limits);
+    _abandoned_before = _pattern.abandoned();
+}
+
+void FileScanner::report_limits(const std::string &name, uint64_t abandoned, bool timed_out, double timeout)
+{
+    if (abandoned > 0)
+        std::cerr << name << ": " << abandoned << (abandoned == 1 ? " line" : " lines")
+                  << " ran out of backtracking steps (--max-steps) and count as not matching" << std::endl;
+    if (timed_out)
+        std::cerr << name << ": search timed out after " << timeout << "s (--timeout); rest of the file skipped"
+                  << std::endl;
+}
+
+bool FileScanner::scan_mapped(int fd, size_t size, const std::string &label, bool &found)
+{
+    void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        return false;
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    const char *begin = static_cast<const char *>(map);
+    _history = begin;
+    found = !is_binary(begin, size) && scan_buffer(begin, begin + size, label);
+    munmap(map, size);
+    return true;
+}
+
+bool FileScanner::scan_stream(int fd, const std::string &label)
+{
+    bool found = false;
+    restart_stream();
+    bool first_read = true;
+    while (!done() || trailing_context())
+    {
+        ssize_t n = read_chunk(fd);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (n == 0)
+            break;
+
+        if (first_read && is_binary(_buffer.data(), static_cast<size_t>(n)))
+            return false;
+        first_read = false;
+        found |= scan_read(static_cast<size_t>(n), label);
+    }
+    return finish_stream(label) || found;
+}
+
+bool FileScanner::scan_appended(int fd, const std::string &label)
+{
+    bool found = false;
+    while (!done() || trailing_context())
+    {
+        ssize_t n = read_chunk(fd);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        found |= scan_read(static_cast<size_t>(n), label);
+    }
+    return found;
+}
+
+void FileScanner::restart_stream()
+{
+    if (_buffer.size() < chunk_size)
+        _buffer.resize(chunk_size);
+    _filled = 0;
+    _scanned = 0;
+    _history = nullptr;
+    _printed_end = nullptr;
+    _after_left = 0;
+}
+
+bool FileScanner::finish_stream(const std::string &label)
+{
+    bool found = false;
+    if (_filled > _scanned && (!done() || trailing_context()))
+    {
+        _history = _buffer.data();
+        found = scan_buffer(_buffer.data() + _scanned, _buffer.data() + _filled, label);
+        // the tail lacks its newline but is a line: after a rotation the
+        // next file numbers on from it
+        if (_line_numbers)
+            ++_lines;
+    }
+    restart_stream();
+    return found;
+}
+
+ssize_t FileScanner::read_chunk(int fd)
+{
+    if (_filled == _buffer.size())
+    {
+        // a single line longer than the buffer
+        size_t printed = _printed_end ? static_cast<size_t>(_printed_end - _buffer.data()) : 0;
+        _buffer.resize(_buffer.size() * 2);
+        if (_printed_end)
+            _printed_end = _buffer.data() + printed;
+    }
+
+    auto started = _stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+    ssize_t n = read(fd, _buffer.data() + _filled, _buffer.size() - _filled);
+    if (_stats)
+        _stats->read_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return n;
+}
+
+bool FileScanner::scan_read(size_t n, const std::string &label)
+{
+    const char *data = _buffer.data();
+    const char *last_newline = static_cast<const char *>(memrchr(data + _filled, '\n', n));
+    _filled += n;
+    if (!last_newline)
+        return false;
+
+    // only complete lines are scanned; the tail waits for the next read
+    const char *complete = last_newline + 1;
+    _history = data;
+    bool found = scan_buffer(data + _scanned, complete, label);
+
+    const char *keep = history_start(data, complete);
+    size_t shift = static_cast<size_t>(keep - data);
+    if (_printed_end)
+        _printed_end = _printed_end >= keep ? _printed_end - shift : nullptr;
+    std::memmove(_buffer.data(), keep, _filled - shift);
+    _filled -= shift;
+    _scanned = static_cast<size_t>(complete - keep);
+    return found;
+}
+
+bool FileScanner::scan_buffer(const char *begin, const char *end, const std::string &label)
+{
+    bool found = false;
+    bool context = _context && _mode == PRINT_LINES;
+    bool count_lines = _line_numbers || _stats;
+    const char *pos = begin;
+    const char *counted = begin; // newlines before this point are in _lines
+    _pattern.reset();
+    while (pos < end && !done())
+    {
+        const char *hit = _pattern.find_line(pos, end);
+        if (!hit)
+            break;
+
+        const char *prev_newline = static_cast<const char *>(memrchr(pos, '\n', static_cast<size_t>(hit - pos)));
+        const char *line_begin = prev_newline ? prev_newline + 1 : pos;
+        const char *line_end = static_cast<const char *>(memchr(hit, '\n', static_cast<size_t>(end - hit)));
+        if (!line_end)
+            line_end = end;
+
+        size_t line = 0;
+        if (count_lines)
+        {
+            _lines += static_cast<size_t>(std::count(counted, line_begin, '\n'));
+            counted = line_begin;
+            line = _line_numbers ? _lines + 1 : 0;
+        }
+        ++_matched;
+        if (context)
+        {
+            print_after(line_begin, label);
+            print_before(line_begin, label, line);
+            print_line(line_begin, line_end, label, line, ':');
+            _after_left = _after;
+        }
+        else if (_mode == PRINT_LINES)
+            emit(line_begin, line_end, label, line);
+        found = true;
+        pos = line_end + 1;
+    }
+    // -A lines after the last hit, also once -m is reached
+    if (context)
+        print_after(end, label);
+    // an early stop leaves the rest of the buffer unread
+    const char *scanned = done() ? std::min(pos, end) : end;
+    _bytes += static_cast<size_t>(scanned - begin);
+    if (count_lines && counted < scanned)
+        _lines += static_cast<size_t>(std::count(counted, scanned, '\n'));
+    return found;
+}
+
+void FileScanner::emit(const char *begin, const char *end, const std::string &label, size_t line, char separator)
+{
+    if (_hits)
+    {
+        _hits->push_back({line, begin, end});
+        return;
+    }
+    if (_out)
+    {
+        if (!label.empty())
+            _out->append(label).push_back(separator);
+        if (line > 0)
+            _out->append(std::to_string(line)).push_back(separator);
+        _out->append(begin, end).push_back('\n');
+        return;
+    }
+    write_line(*_sink, label, line, begin, end, separator);
+}
+
+void FileScanner::print_line(const char *begin, const char *end, const std::string &label, size_t line, char separator)
+{
+    if (_printed_any && begin != _printed_end)
+    {
+        if (_out)
+            _out->append("--\n");
+        else
+        {
+            _sink->write("--");
+            _sink->end_line();
+        }
+    }
+    emit(begin, end, label, line, separator);
+    _printed_end = end + 1;
+    _printed_line = line;
+    _printed_any = true;
+}
+
+void FileScanner::print_before(const char *line_begin, const std::string &label, size_t line)
+{
+    // neither into lines already printed nor into ones no longer buffered
+    const char *lower = _history && _history <= line_begin ? _history : line_begin;
+    if (_printed_end && _printed_end > lower && _printed_end <= line_begin)
+        lower = _printed_end;
+
+    size_t count = 0;
+    for (const char *pos = line_begin; count < _before && pos > lower; ++count)
+    {
+        const char *newline = static_cast<const char *>(memrchr(lower, '\n', static_cast<size_t>(pos - 1 - lower)));
+        const char *start = newline ? newline + 1 : lower;
+        _before_lines[count] = {start, pos - 1};
+        pos = start;
+    }
+    for (size_t i = count; i-- > 0;)
+        print_line(_before_lines[i].first, _before_lines[i].second, label, line > 0 ? line - 1 - i : 0, '-');
+}
+
+void FileScanner::print_after(const char *limit, const std::string &label)
+{
+    while (_after_left > 0 && _printed_end && _printed_end < limit)
+    {
+        const char *line_end = static_cast<const char *>(memchr(_printed_end, '\n', static_cast<size_t>(limit - _printed_end)));
+        if (!line_end)
+            line_end = limit;
+        --_after_left;
+        print_line(_printed_end, line_end, label, _printed_line > 0 ? _printed_line + 1 : 0, '-');
+    }
+}
+
+const char *FileScanner::history_start(const char *begin, const char *end) const
+{
+    const char *pos = end;
+    for (size_t count = 0; count < _before && pos > begin; ++count)
+    {
+        const char *newline = static_cast<const char *>(memrchr(begin, '\n', static_cast<size_t>(pos - 1 - begin)));
+        pos = newline ? newline + 1 : begin;
+    }
+    return pos;
+}
+
+void FileScanner::emit_summary(const std::string &text)
+{
+    if (_out)
+    {
+        _out->append(text).push_back('\n');
+        return;
+    }
+    _sink->write(text);
+    _sink->end_line();
+}
+
+void FileScanner::write_line(OutputSink &sink, const std::string &label, size_t line, const char *begin, const char *end,
+                             char separator)
+{
+    if (!label.empty())
+    {
+        sink.write(label);
+        sink.put(separator);
+    }
+    if (line > 0)
+    {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), line);
+        sink.write(digits, static_cast<size_t>(result.ptr - digits));
+        sink.put(separator);
+    }
+    sink.write(begin, static_cast<size_t>(end - begin));
+    sink.end_line();
+}
@@ -0,0 +1,164 @@
+#include "include/IgnoreRules.h"
+
+#include <fstream>
+
+// [...] at p; sets matched and returns the byte after the closing ']', or
+// nullptr when the class is not closed (and so '[' is a plain byte)
+static const char *match_class(const char *p, const char *end, unsigned char c, bool &matched)
+{
+    ++p;
+    bool negated = p < end && (*p == '!' || *p == '^');
+    if (negated)
+        ++p;
+    matched = false;
+    for (bool first = true; p < end && (first || *p != ']'); first = false)
+    {
+        unsigned char lo = static_cast<unsigned char>(*p == '\\' && p + 1 < end ? *++p : *p);
+        ++p;
+        unsigned char hi = lo;
+        if (p + 1 < end && *p == '-' && p[1] != ']')
+        {
+            ++p;
+            hi = static_cast<unsigned char>(*p == '\\' && p + 1 < end ? *++p : *p);
+            ++p;
+        }
+        matched |= lo <= c && c <= hi;
+    }
+    if (p >= end)
+        return nullptr;
+    matched ^= negated;
+    return p + 1;
+}
+
+static bool match_from(const char *p, const char *pend, const char *t, const char *tend)
+{
+    while (p < pend)
+    {
+        if (*p == '*')
+        {
+            if (p + 1 < pend && p[1] == '*')
+            {
+                p += 2;
+                if (p < pend && *p == '/')
+                {
+                    // "**/" stands for any number of whole directories, none included
+                    ++p;
+                    if (match_from(p, pend, t, tend))
+                        return true;
+                    for (const char *s = t; s < tend; ++s)
+                    {
+                        if (*s == '/' && match_from(p, pend, s + 1, tend))
+                            return true;
+                    }
+                    return false;
+                }
+                for (const char *s = t;; ++s)
+                {
+                    if (match_from(p, pend, s, tend))
+                        return true;
+                    if (s == tend)
+                        return false;
+                }
+            }
+            ++p;
+            for (const char *s = t;; ++s)
+            {
+                if (match_from(p, pend, s, tend))
+                    return true;
+                if (s == tend || *s == '/')
+                    return false;
+            }
+        }
+
+        if (t == tend)
+            return false;
+        unsigned char c = static_cast<unsigned char>(*t);
+        if (*p == '?')
+        {
+            if (c == '/')
+                return false;
+            ++p;
+            ++t;
+            continue;
+        }
+        if (*p == '[')
+        {
+            bool matched;
+            if (const char *next = match_class(p, pend, c, matched))
+            {
+                if (!matched || c == '/')
+                    return false;
+                p = next;
+                ++t;
+                continue;
+            }
+        }
+        if (*p == '\\' && p + 1 < pend)
+            ++p;
+        if (static_cast<unsigned char>(*p) != c)
+            return false;
+        ++p;
+        ++t;
+    }
+    return t == tend;
+}
+
+bool glob_match(std::string_view pattern, std::string_view text)
+{
+    return match_from(pattern.data(), pattern.data() + pattern.size(), text.data(), text.data() + text.size());
+}
+
+bool IgnoreRules::load(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    std::string line;
+    while (std::getline(file, line))
+        add(line);
+    return true;
+}
+
+void IgnoreRules::add(std::string_view line)
+{
+    if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+    // trailing spaces do not count unless quoted with '\'
+    while (!line.empty() && line.back() == ' ' && !(line.size() >= 2 && line[line.size() - 2] == '\\'))
+        line.remove_suffix(1);
+    if (line.empty() || line[0] == '#')
+        return;
+
+    Rule rule;
+    if (line[0] == '!')
+    {
+        rule.negated = true;
+        line.remove_prefix(1);
+    }
+    if (!line.empty() && line.back() == '/')
+    {
+        rule.dir_only = true;
+        line.remove_suffix(1);
+    }
+    rule.anchored = line.find('/') != std::string_view::npos;
+    if (!line.empty() && line[0] == '/')
+        line.remove_prefix(1);
+    if (line.empty())
+        return;
+    rule.glob = line;
+    _rules.push_back(std::move(rule));
+}
+
+IgnoreMatch IgnoreRules::match(std::string_view path, bool is_dir) const
+{
+    size_t slash = path.rfind('/');
+    std::string_view name = slash == std::string_view::npos ? path : path.substr(slash + 1);
+    for (auto it = _rules.rbegin(); it != _rules.rend(); ++it)
+    {
+        if (it->dir_only && !is_dir)
+            continue;
+        if (glob_match(it->glob, it->anchored ? path : name))
+            return it->negated ? IGNORE_INCLUDE : IGNORE_SKIP;
+    }
+    return IGNORE_NONE;
+}
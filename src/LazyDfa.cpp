@@ -0,0 +1,200 @@
+#include "include/LazyDfa.h"
+
+#include <algorithm>
+#include <cstring>
+
+size_t LazyDfa::KeyHash::operator()(const std::vector<int> &key) const
+{
+    size_t h = key.size();
+    for (int v : key)
+        h ^= static_cast<size_t>(v) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+}
+
+LazyDfa::LazyDfa(Nfa nfa) : _nfa(std::move(nfa))
+{
+    _visited.assign(_nfa.states.size(), 0);
+    flush_cache();
+}
+
+bool LazyDfa::match(const char *begin, const char *end)
+{
+    int s = _initial;
+    for (const char *p = begin; p < end; ++p)
+    {
+        const DState &state = _states[s];
+        if (state.is_match)
+            return true;
+        if (state.is_dead)
+            return false;
+        s = next_state(s, static_cast<unsigned char>(*p));
+    }
+    return _states[s].is_match || _states[s].accepts_at_eol;
+}
+
+const char *LazyDfa::find_line(const char *begin, const char *end)
+{
+    int s = _initial;
+    const char *p = begin;
+    while (p < end)
+    {
+        unsigned char byte = static_cast<unsigned char>(*p);
+        if (byte == '\n')
+        {
+            if (_states[s].accepts_at_eol)
+                return p;
+            s = _initial;
+            ++p;
+            continue;
+        }
+        if (_states[s].is_match)
+            return p;
+
+        s = next_state(s, byte);
+        if (_states[s].is_match)
+            return p;
+        if (_states[s].is_dead)
+        {
+            // nothing can match on the rest of this line
+            p = static_cast<const char *>(memchr(p, '\n', static_cast<size_t>(end - p)));
+            if (!p)
+                return nullptr;
+            s = _initial;
+        }
+        ++p;
+    }
+    // a final line without its '\n'
+    if (p > begin && p[-1] != '\n' && _states[s].accepts_at_eol)
+        return p - 1;
+    return nullptr;
+}
+
+// Expands `set` in place to its epsilon closure. Only states that matter
+// for later steps (BYTE, EOL, MATCH) are kept, sorted, to form the DFA key.
+void LazyDfa::closure(std::vector<int> &set, bool bol, bool eol)
+{
+    if (++_generation == 0)
+    {
+        std::fill(_visited.begin(), _visited.end(), 0);
+        _generation = 1;
+    }
+
+    _stack.assign(set.begin(), set.end());
+    set.clear();
+    while (!_stack.empty())
+    {
+        int id = _stack.back();
+        _stack.pop_back();
+        if (id < 0 || _visited[id] == _generation)
+            continue;
+        _visited[id] = _generation;
+
+        const NfaState &st = _nfa.states[id];
+        switch (st.op)
+        {
+        case NFA_SPLIT:
+            _stack.push_back(st.out1);
+            _stack.push_back(st.out);
+            break;
+        case NFA_BOL:
+            if (bol)
+                _stack.push_back(st.out);
+            break;
+        case NFA_EOL:
+            set.push_back(id);
+            if (eol)
+                _stack.push_back(st.out);
+            break;
+        case NFA_SAVE:
+        case NFA_PROGRESS:
+            // captures and loop guards do not change what matches
+            _stack.push_back(st.out);
+            break;
+        default:
+            set.push_back(id);
+            break;
+        }
+    }
+    std::sort(set.begin(), set.end());
+}
+
+int LazyDfa::add_state(std::vector<int> set, bool bol)
+{
+    // the bol flag is part of the identity of a state
+    set.push_back(bol ? -1 : -2);
+    auto it = _index.find(set);
+    if (it != _index.end())
+        return it->second;
+    set.pop_back();
+
+    DState state;
+    state.bol = bol;
+    bool has_byte = false;
+    for (int id : set)
+    {
+        NfaOp op = _nfa.states[id].op;
+        state.is_match |= op == NFA_MATCH;
+        has_byte |= op == NFA_BYTE;
+    }
+
+    std::vector<int> at_eol = set;
+    closure(at_eol, bol, true);
+    for (int id : at_eol)
+        state.accepts_at_eol |= _nfa.states[id].op == NFA_MATCH;
+
+    // only the unanchored restart can revive a state with nothing left to consume,
+    // and that restart is folded into every transition
+    state.is_dead = !has_byte && !state.is_match && !state.accepts_at_eol;
+    state.nfa_states = std::move(set);
+
+    ++_built;
+    int id = static_cast<int>(_states.size());
+    std::vector<int> key = state.nfa_states;
+    key.push_back(bol ? -1 : -2);
+    _index.emplace(std::move(key), id);
+    _states.push_back(std::move(state));
+    _trans.resize(_states.size() * 256, -1);
+    return id;
+}
+
+int LazyDfa::next_state(int state, unsigned char byte)
+{
+    int32_t cached = _trans[static_cast<size_t>(state) * 256 + byte];
+    if (cached >= 0)
+        return cached;
+
+    if (_states.size() >= max_states)
+    {
+        // keep memory bounded: start over with only the state we are in
+        DState current = _states[state];
+        ++_flushes;
+        flush_cache();
+        state = add_state(current.nfa_states, current.bol);
+    }
+
+    std::vector<int> next;
+    for (int id : _states[state].nfa_states)
+    {
+        const NfaState &st = _nfa.states[id];
+        if (st.op == NFA_BYTE && _nfa.sets[st.set].test(byte))
+            next.push_back(st.out);
+    }
+    // unanchored search: a new attempt may begin after every byte
+    next.push_back(_nfa.start);
+    closure(next, false, false);
+
+    int target = add_state(std::move(next), false);
+    _trans[static_cast<size_t>(state) * 256 + byte] = target;
+    return target;
+}
+
+void LazyDfa::flush_cache()
+{
+    _states.clear();
+    _trans.clear();
+    _index.clear();
+
+    std::vector<int> initial{_nfa.start};
+    closure(initial, true, false);
+    _initial = add_state(std::move(initial), true);
+}
@@ -0,0 +1,301 @@
+#include "include/Nfa.h"
+#include "include/RegParser.h"
+
+#include <algorithm>
+
+bool Nfa::compile(const TokenList &token_list)
+{
+    states.clear();
+    sets.clear();
+    has_backrefs = false;
+    start = -1;
+
+    // group slots first, so loop guards can be numbered from slot_count on
+    slot_count = 2 * max_group(token_list) + 2;
+
+    int match_state = add_state(NFA_MATCH);
+    int body = compile_list(token_list, add_save(1, match_state));
+    if (body < 0)
+        return false;
+    start = add_save(0, body);
+    return true;
+}
+
+bool Nfa::merge(const std::vector<const Nfa *> &programs)
+{
+    states.clear();
+    sets.clear();
+    slot_count = 2;
+    has_backrefs = false;
+    start = -1;
+
+    // states and sets are addressed by index, so a program is copied by
+    // shifting its indices past the programs before it
+    std::vector<int> starts;
+    for (const Nfa *program : programs)
+    {
+        int state_offset = static_cast<int>(states.size());
+        int set_offset = static_cast<int>(sets.size());
+        for (NfaState st : program->states)
+        {
+            if (st.out >= 0)
+                st.out += state_offset;
+            if (st.out1 >= 0)
+                st.out1 += state_offset;
+            if (st.set >= 0)
+                st.set += set_offset;
+            states.push_back(st);
+        }
+        sets.insert(sets.end(), program->sets.begin(), program->sets.end());
+        slot_count = std::max(slot_count, program->slot_count);
+        has_backrefs |= program->has_backrefs;
+        starts.push_back(program->start + state_offset);
+    }
+
+    for (auto it = starts.rbegin(); it != starts.rend(); ++it)
+        start = start < 0 ? *it : add_state(NFA_SPLIT, *it, start);
+    return start >= 0;
+}
+
+void Nfa::relax_backrefs()
+{
+    if (!has_backrefs)
+        return;
+    CharSet line;
+    line.set_all();
+    line.reset('\n');
+    int set = static_cast<int>(sets.size());
+    sets.push_back(line);
+
+    size_t count = states.size();
+    for (size_t id = 0; id < count; ++id)
+    {
+        if (states[id].op != NFA_BACKREF)
+            continue;
+        int byte = add_state(NFA_BYTE, static_cast<int>(id), -1, set);
+        states[id] = NfaState{NFA_SPLIT, byte, states[id].out};
+    }
+    has_backrefs = false;
+}
+
+void Nfa::drop_captures()
+{
+    std::vector<bool> keep(static_cast<size_t>(slot_count));
+    for (const NfaState &st : states)
+    {
+        if (st.op == NFA_BACKREF)
+            keep[2 * st.slot] = keep[2 * st.slot + 1] = true;
+        else if (st.op == NFA_PROGRESS)
+            keep[st.slot] = true;
+    }
+
+    // a chain of SAVE states never loops back without a SPLIT, so every walk ends
+    auto skip = [&](int id)
+    {
+        while (id >= 0 && states[id].op == NFA_SAVE && !keep[states[id].slot])
+            id = states[id].out;
+        return id;
+    };
+    for (NfaState &st : states)
+    {
+        st.out = skip(st.out);
+        st.out1 = skip(st.out1);
+    }
+    start = skip(start);
+}
+
+int Nfa::add_state(NfaOp op, int out, int out1, int set)
+{
+    states.push_back({op, out, out1, set});
+    return static_cast<int>(states.size()) - 1;
+}
+
+int Nfa::add_save(int slot, int next)
+{
+    int id = add_state(NFA_SAVE, next);
+    states[id].slot = slot;
+    slot_count = std::max(slot_count, slot + 1);
+    return id;
+}
+
+// Builds back to front: every element is compiled with its continuation
+// already known, so no dangling outputs have to be patched afterwards.
+int Nfa::compile_list(const TokenList &token_list, int next)
+{
+    const auto &regex = token_list.regex;
+    for (auto it = regex.rbegin(); it != regex.rend() && next >= 0; ++it)
+        next = compile_re(*it, next);
+    return next;
+}
+
+int Nfa::compile_re(const Re &re, int next)
+{
+    switch (re.quantifier)
+    {
+    case PLUS:
+        return compile_repeat(re, 1, -1, next);
+    case STAR:
+        return compile_repeat(re, 0, -1, next);
+    case MARK:
+        return compile_repeat(re, 0, 1, next);
+    case REPEAT:
+        return compile_repeat(re, re.repeat_min, re.repeat_max, next);
+    case NONE:
+    default:
+        return compile_atom(re, next);
+    }
+}
+
+// SPLIT between another round of body and leaving; lazy quantifiers prefer leaving
+int Nfa::add_split(const Re &re, int body, int exit)
+{
+    return re.lazy ? add_state(NFA_SPLIT, exit, body) : add_state(NFA_SPLIT, body, exit);
+}
+
+// Counted repetition without any counters: min mandatory copies of the
+// element followed by either a loop (unbounded) or max - min nested optional
+// copies, x{1,3} = x(x(x)?)?. Nesting keeps every way of matching a given
+// number of rounds unique, so the backtracker never retries equivalent splits.
+int Nfa::compile_repeat(const Re &re, int min, int max, int next)
+{
+    int exit = next;
+    if (max < 0)
+    {
+        if (min > 0 && !nullable(re))
+        {
+            // x{2,} = x x+: the last mandatory copy doubles as the loop body
+            int loop = add_split(re, -1, next);
+            int body = compile_atom(re, loop);
+            (re.lazy ? states[loop].out1 : states[loop].out) = body;
+            next = body;
+            --min;
+        }
+        else
+            next = compile_loop(re, next);
+    }
+    else
+    {
+        for (int i = min; i < max && next >= 0 && states.size() <= max_states; ++i)
+        {
+            int body = compile_atom(re, next);
+            next = body < 0 ? -1 : add_split(re, body, exit);
+        }
+    }
+
+    for (int i = 0; i < min && next >= 0 && states.size() <= max_states; ++i)
+        next = compile_atom(re, next);
+    return states.size() > max_states ? -1 : next;
+}
+
+// x*: a body that can match the empty string is guarded so that a round which
+// consumed nothing leaves the loop instead of going around again
+int Nfa::compile_loop(const Re &re, int next)
+{
+    int loop = add_split(re, -1, next);
+    int body;
+    if (nullable(re))
+    {
+        // loops nested in the body get their own guards
+        int guard = slot_count++;
+        int progress = add_state(NFA_PROGRESS, loop, next);
+        states[progress].slot = guard;
+        body = compile_atom(re, progress);
+        body = body < 0 ? -1 : add_save(guard, body);
+    }
+    else
+        body = compile_atom(re, loop);
+    if (body < 0)
+        return -1;
+    (re.lazy ? states[loop].out1 : states[loop].out) = body;
+    return loop;
+}
+
+int Nfa::compile_atom(const Re &re, int next)
+{
+    switch (re.type)
+    {
+    case START:
+        return add_state(NFA_BOL, next);
+    case END:
+        return add_state(NFA_EOL, next);
+    case SINGLE_CHAR:
+    case DIGIT:
+    case ALPHANUM:
+    case LIST:
+        // classes are compiled to bitmaps by the parser; the NFA shares them
+        sets.push_back(re.set);
+        return add_state(NFA_BYTE, next, -1, static_cast<int>(sets.size()) - 1);
+    case STRING:
+        for (auto it = re.ccl.rbegin(); it != re.ccl.rend(); ++it)
+        {
+            CharSet byte;
+            byte.set(static_cast<unsigned char>(*it));
+            sets.push_back(byte);
+            next = add_state(NFA_BYTE, next, -1, static_cast<int>(sets.size()) - 1);
+        }
+        return next;
+    case ALT:
+    {
+        // alternatives are chained through SPLIT states in source order;
+        // a capturing group is bracketed by the SAVE states of its slots
+        bool captured = re.captured_gp_id >= 0;
+        if (captured)
+            next = add_save(2 * re.captured_gp_id + 1, next);
+        int entry = -1;
+        for (auto it = re.alternatives.rbegin(); it != re.alternatives.rend(); ++it)
+        {
+            int alt = compile_list(*it, next);
+            if (alt < 0)
+                return -1;
+            entry = entry < 0 ? alt : add_state(NFA_SPLIT, alt, entry);
+        }
+        if (entry < 0)
+            entry = next;
+        return captured ? add_save(2 * re.captured_gp_id, entry) : entry;
+    }
+    case BACKREF:
+    {
+        has_backrefs = true;
+        int id = add_state(NFA_BACKREF, next);
+        states[id].slot = re.captured_gp_id;
+        return id;
+    }
+    default:
+        return -1;
+    }
+}
+
+// true when re can match without consuming input
+bool Nfa::nullable(const Re &re)
+{
+    if (re.quantifier == STAR || re.quantifier == MARK || (re.quantifier == REPEAT && re.repeat_min == 0))
+        return true;
+    switch (re.type)
+    {
+    case START:
+    case END:
+    case BACKREF: // the group may have captured the empty string
+        return true;
+    case ALT:
+        for (const TokenList &alt : re.alternatives)
+        {
+            if (std::all_of(alt.regex.begin(), alt.regex.end(), nullable))
+                return true;
+        }
+        return re.alternatives.empty();
+    default:
+        return false;
+    }
+}
+
+int Nfa::max_group(const TokenList &token_list)
+{
+    int group = 0;
+    for (const Re &re : token_list.regex)
+    {
+        group = std::max(group, re.captured_gp_id);
+        for (const TokenList &alt : re.alternatives)
+            group = std::max(group, max_group(alt));
+    }
+    return group;
+}
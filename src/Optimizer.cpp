@@ -0,0 +1,260 @@
+#include "include/Optimizer.h"
+#include "include/RegParser.h"
+
+#include <iterator>
+#include <utility>
+
+// one byte out of a set, matched exactly once
+static bool is_class(const Re &re)
+{
+    if (re.quantifier != NONE)
+        return false;
+    return re.type == SINGLE_CHAR || re.type == DIGIT || re.type == ALPHANUM || re.type == LIST;
+}
+
+// elements that can match in only one way, so matching a shared one once
+// for several alternatives leaves nothing for the search to retry
+static bool same_fixed(const Re &a, const Re &b)
+{
+    if (is_class(a) && is_class(b))
+        return a.set == b.set;
+    return a.quantifier == NONE && b.quantifier == NONE && a.type == b.type && (a.type == START || a.type == END);
+}
+
+// a group made here; it has no capture slots to keep
+static Re make_group(std::vector<TokenList> alternatives)
+{
+    Re group;
+    group.type = ALT;
+    group.alternatives = std::move(alternatives);
+    return group;
+}
+
+// appends re to list, dissolving a group without a capture where it can:
+// (xy) becomes xy and (x)* becomes x*
+static void append(std::vector<Re> &list, Re re)
+{
+    if (re.type == ALT && re.captured_gp_id < 0 && re.alternatives.size() == 1)
+    {
+        std::vector<Re> &body = re.alternatives[0].regex;
+        if (re.quantifier == NONE)
+        {
+            list.insert(list.end(), std::make_move_iterator(body.begin()), std::make_move_iterator(body.end()));
+            return;
+        }
+        if (body.size() == 1 && body[0].quantifier == NONE)
+        {
+            Re element = std::move(body[0]);
+            element.quantifier = re.quantifier;
+            element.repeat_min = re.repeat_min;
+            element.repeat_max = re.repeat_max;
+            element.lazy = re.lazy;
+            list.push_back(std::move(element));
+            return;
+        }
+    }
+    list.push_back(std::move(re));
+}
+
+static void simplify_group(Re &group);
+
+// Consecutive alternatives only: (ab|x|ac) must keep trying x before ac.
+static void factor_prefixes(Re &group)
+{
+    std::vector<TokenList> &alternatives = group.alternatives;
+    std::vector<TokenList> factored;
+    for (size_t i = 0; i < alternatives.size();)
+    {
+        std::vector<Re> &first = alternatives[i].regex;
+        size_t j = i + 1;
+        while (j < alternatives.size() && !first.empty() && !alternatives[j].regex.empty() &&
+               same_fixed(first[0], alternatives[j].regex[0]))
+        {
+            ++j;
+        }
+        if (j - i < 2)
+        {
+            factored.push_back(std::move(alternatives[i++]));
+            continue;
+        }
+
+        size_t shared = 1;
+        for (bool longer = true; longer; shared += longer)
+        {
+            for (size_t k = i + 1; k < j && longer; ++k)
+            {
+                const std::vector<Re> &other = alternatives[k].regex;
+                longer = shared < first.size() && shared < other.size() && same_fixed(first[shared], other[shared]);
+            }
+        }
+
+        std::vector<TokenList> rest;
+        for (size_t k = i; k < j; ++k)
+        {
+            std::vector<Re> &regex = alternatives[k].regex;
+            TokenList tail;
+            tail.regex.assign(std::make_move_iterator(regex.begin() + static_cast<std::ptrdiff_t>(shared)),
+                              std::make_move_iterator(regex.end()));
+            rest.push_back(std::move(tail));
+        }
+        TokenList merged;
+        merged.regex.assign(std::make_move_iterator(first.begin()),
+                            std::make_move_iterator(first.begin() + static_cast<std::ptrdiff_t>(shared)));
+        Re tails = make_group(std::move(rest));
+        simplify_group(tails);
+        append(merged.regex, std::move(tails));
+        factored.push_back(std::move(merged));
+        i = j;
+    }
+    alternatives = std::move(factored);
+}
+
+// (a|b|\d) matches one byte out of the union either way, and being
+// consecutive the classes were tried at the same point of the order
+static void merge_classes(Re &group)
+{
+    std::vector<TokenList> merged;
+    for (TokenList &alternative : group.alternatives)
+    {
+        bool single = alternative.regex.size() == 1 && is_class(alternative.regex[0]);
+        if (single && !merged.empty() && merged.back().regex.size() == 1 && is_class(merged.back().regex[0]))
+        {
+            Re &set = merged.back().regex[0];
+            set.type = LIST;
+            set.isNegative = false;
+            set.ccl += alternative.regex[0].ccl;
+            set.set.merge(alternative.regex[0].set);
+            continue;
+        }
+        merged.push_back(std::move(alternative));
+    }
+    group.alternatives = std::move(merged);
+}
+
+static void simplify_group(Re &group)
+{
+    factor_prefixes(group);
+    merge_classes(group);
+
+    // what factoring leaves of (ab|abc) and (abc|ab): an optional tail, lazy
+    // when the empty alternative came first
+    if (group.captured_gp_id < 0 && group.quantifier == NONE && group.alternatives.size() == 2)
+    {
+        bool first_empty = group.alternatives[0].regex.empty();
+        bool second_empty = group.alternatives[1].regex.empty();
+        if (first_empty || second_empty)
+        {
+            group.alternatives.erase(group.alternatives.begin() + (first_empty ? 0 : 1));
+            if (!first_empty || !second_empty)
+            {
+                group.quantifier = MARK;
+                group.lazy = first_empty;
+            }
+        }
+    }
+}
+
+static void simplify_list(std::vector<Re> &list)
+{
+    std::vector<Re> simplified;
+    for (Re &re : list)
+    {
+        if (re.type == ALT)
+        {
+            for (TokenList &alternative : re.alternatives)
+                simplify_list(alternative.regex);
+            simplify_group(re);
+        }
+        append(simplified, std::move(re));
+    }
+    list = std::move(simplified);
+}
+
+// escaped bytes and one-member classes such as [[] are literal bytes too
+static int literal_byte(const Re &re)
+{
+    return is_class(re) ? re.set.single() : -1;
+}
+
+static void merge_strings(std::vector<Re> &list)
+{
+    std::vector<Re> merged;
+    for (Re &re : list)
+    {
+        for (TokenList &alternative : re.alternatives)
+            merge_strings(alternative.regex);
+
+        int byte = literal_byte(re);
+        if (byte >= 0 && !merged.empty() && (merged.back().type == STRING || literal_byte(merged.back()) >= 0))
+        {
+            Re &run = merged.back();
+            if (run.type != STRING)
+            {
+                run.ccl.assign(1, static_cast<char>(literal_byte(run)));
+                run.type = STRING;
+                run.isNegative = false;
+                run.set = CharSet();
+            }
+            run.ccl.push_back(static_cast<char>(byte));
+            continue;
+        }
+        merged.push_back(std::move(re));
+    }
+    list = std::move(merged);
+}
+
+void optimize_pattern(TokenList &token_list)
+{
+    // factoring compares single bytes, so strings are only formed afterwards
+    simplify_list(token_list.regex);
+    merge_strings(token_list.regex);
+}
+
+static void flush_run(std::string &run, std::string &best)
+{
+    if (run.size() > best.size())
+        best = run;
+    run.clear();
+}
+
+// Walks the mandatory path of the pattern: only elements that every match
+// passes through exactly once can extend a run of literal bytes.
+static void collect_literals(const TokenList &token_list, std::string &run, std::string &best)
+{
+    for (const Re &re : token_list.regex)
+    {
+        // escaped bytes and one-member classes such as [[] are literals too
+        int byte = re.set.single();
+        bool repeated = re.quantifier == PLUS || (re.quantifier == REPEAT && re.repeat_min >= 1);
+
+        if (re.type == STRING)
+            run += re.ccl;
+        else if (byte >= 0 && re.quantifier == NONE)
+            run.push_back(static_cast<char>(byte));
+        else if (byte >= 0 && repeated)
+        {
+            // "a+" starts with one 'a', but more may follow before the next element
+            run.push_back(static_cast<char>(byte));
+            flush_run(run, best);
+        }
+        else if (re.type == ALT && re.alternatives.size() == 1 && re.quantifier == NONE)
+            collect_literals(re.alternatives[0], run, best);
+        else if (re.type == ALT && re.alternatives.size() == 1 && repeated)
+        {
+            flush_run(run, best);
+            collect_literals(re.alternatives[0], run, best);
+            flush_run(run, best);
+        }
+        else
+            flush_run(run, best);
+    }
+}
+
+std::string required_literal(const TokenList &token_list)
+{
+    std::string run;
+    std::string best;
+    collect_literals(token_list, run, best);
+    flush_run(run, best);
+    return best;
+}
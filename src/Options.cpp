@@ -0,0 +1,298 @@
+#include "include/Options.h"
+
+#include <fstream>
+#include <iostream>
+
+// reads the value of an option given either as "-jN" or as "-j N"
+static bool option_value(int argc, char *argv[], int &i, const std::string &arg, size_t flag_length, std::string &value)
+{
+    if (arg.size() > flag_length)
+    {
+        value = arg.substr(flag_length);
+        if (value[0] == '=')
+            value.erase(0, 1);
+        return true;
+    }
+    if (i + 1 >= argc)
+    {
+        std::cerr << "Option " << arg << " requires an argument" << std::endl;
+        return false;
+    }
+    value = argv[++i];
+    return true;
+}
+
+static bool parse_count(const std::string &flag, const std::string &value, size_t &out)
+{
+    try
+    {
+        size_t used = 0;
+        long long n = std::stoll(value, &used);
+        if (used == value.size() && n >= 0)
+        {
+            out = static_cast<size_t>(n);
+            return true;
+        }
+    }
+    catch (const std::exception &)
+    {
+    }
+    std::cerr << "Invalid argument for " << flag << ": " << value << std::endl;
+    return false;
+}
+
+static bool parse_seconds(const std::string &flag, const std::string &value, double &out)
+{
+    try
+    {
+        size_t used = 0;
+        double seconds = std::stod(value, &used);
+        if (used == value.size() && seconds >= 0)
+        {
+            out = seconds;
+            return true;
+        }
+    }
+    catch (const std::exception &)
+    {
+    }
+    std::cerr << "Invalid argument for " << flag << ": " << value << std::endl;
+    return false;
+}
+
+// one pattern per line, as grep does for -e values with embedded newlines
+static void add_patterns(const std::string &text, std::vector<std::string> &patterns)
+{
+    size_t pos = 0;
+    while (true)
+    {
+        size_t newline = text.find('\n', pos);
+        if (newline == std::string::npos)
+        {
+            patterns.push_back(text.substr(pos));
+            return;
+        }
+        patterns.push_back(text.substr(pos, newline - pos));
+        pos = newline + 1;
+    }
+}
+
+static bool read_pattern_file(const std::string &path, std::vector<std::string> &patterns)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "Failed to read pattern file: " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line))
+        patterns.push_back(line);
+    return true;
+}
+
+bool parse_options(int argc, char *argv[], Options &opts)
+{
+    bool has_pattern = false;
+    bool only_positional = false;
+    // -C only sets the sides that -A and -B leave alone, whatever the order
+    bool has_after = false;
+    bool has_before = false;
+    bool has_context = false;
+    size_t context = 0;
+
+    int first = 1;
+    if (argc > 1 && std::string(argv[1]) == "index")
+    {
+        opts.index = true;
+        first = 2;
+    }
+
+    for (int i = first; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (only_positional || arg.size() < 2 || arg[0] != '-')
+        {
+            if (!has_pattern && !opts.index)
+            {
+                opts.patterns.push_back(arg);
+                has_pattern = true;
+            }
+            else
+                opts.paths.push_back(arg);
+            continue;
+        }
+
+        std::string value;
+        if (arg == "--")
+            only_positional = true;
+        else if (arg == "-E")
+        {
+            // extended syntax is the only one supported; the pattern is the
+            // first positional argument, or given with -e/-f
+        }
+        else if (arg.rfind("-e", 0) == 0)
+        {
+            if (!option_value(argc, argv, i, arg, 2, value))
+                return false;
+            add_patterns(value, opts.patterns);
+            has_pattern = true;
+        }
+        else if (arg.rfind("-f", 0) == 0)
+        {
+            if (!option_value(argc, argv, i, arg, 2, value) || !read_pattern_file(value, opts.patterns))
+                return false;
+            has_pattern = true;
+        }
+        else if (arg == "-r")
+            opts.recursive = true;
+        else if (arg == "-n")
+            opts.line_numbers = true;
+        else if (arg == "-c" || arg == "-l" || arg == "-L")
+        {
+            // the last one given wins, but nothing overrides -q
+            if (opts.mode != PRINT_NOTHING)
+                opts.mode = arg == "-c" ? PRINT_COUNT : arg == "-l" ? PRINT_MATCHING : PRINT_NON_MATCHING;
+        }
+        else if (arg == "-q")
+            opts.mode = PRINT_NOTHING;
+        else if (arg.rfind("-m", 0) == 0)
+        {
+            if (!option_value(argc, argv, i, arg, 2, value) || !parse_count("-m", value, opts.max_count))
+                return false;
+        }
+        else if (arg.rfind("-A", 0) == 0)
+        {
+            if (!option_value(argc, argv, i, arg, 2, value) || !parse_count("-A", value, opts.after_context))
+                return false;
+            has_after = true;
+        }
+        else if (arg.rfind("-B", 0) == 0)
+        {
+            if (!option_value(argc, argv, i, arg, 2, value) || !parse_count("-B", value, opts.before_context))
+                return false;
+            has_before = true;
+        }
+        else if (arg.rfind("-C", 0) == 0)
+        {
+            if (!option_value(argc, argv, i, arg, 2, value) || !parse_count("-C", value, context))
+                return false;
+            has_context = true;
+        }
+        else if (arg.rfind("-j", 0) == 0)
+        {
+            if (!option_value(argc, argv, i, arg, 2, value) || !parse_count("-j", value, opts.jobs))
+                return false;
+        }
+        else if (arg == "--sort-files")
+            opts.sort_files = true;
+        else if (arg == "--line-buffered")
+            opts.line_buffered = true;
+        else if (arg == "--stats")
+            opts.stats = true;
+        else if (arg == "--follow")
+            opts.follow = true;
+        else if (arg == "--no-index")
+            opts.no_index = true;
+        else if (arg == "--hidden")
+            opts.hidden = true;
+        else if (arg == "--no-ignore")
+            opts.no_ignore = true;
+        else if (arg == "-a" || arg == "--text")
+            opts.text = true;
+        else if (arg.rfind("--io", 0) == 0)
+        {
+            if (!option_value(argc, argv, i, arg, 4, value))
+                return false;
+            if (value == "auto")
+                opts.io = IO_AUTO;
+            else if (value == "uring")
+                opts.io = IO_URING;
+            else if (value == "pread")
+                opts.io = IO_PREAD;
+            else if (value == "sync")
+                opts.io = IO_SYNC;
+            else
+            {
+                std::cerr << "Invalid argument for --io: " << value << std::endl;
+                return false;
+            }
+        }
+        else if (arg.rfind("--include", 0) == 0)
+        {
+            if (!option_value(argc, argv, i, arg, 9, value))
+                return false;
+            opts.include.push_back(value);
+        }
+        else if (arg.rfind("--exclude-dir", 0) == 0)
+        {
+            if (!option_value(argc, argv, i, arg, 13, value))
+                return false;
+            opts.exclude_dir.push_back(value);
+        }
+        else if (arg.rfind("--exclude", 0) == 0)
+        {
+            if (!option_value(argc, argv, i, arg, 9, value))
+                return false;
+            opts.exclude.push_back(value);
+        }
+        else if (arg.rfind("--max-steps", 0) == 0)
+        {
+            size_t steps = 0;
+            if (!option_value(argc, argv, i, arg, 11, value) || !parse_count("--max-steps", value, steps))
+                return false;
+            opts.max_steps = steps;
+        }
+        else if (arg.rfind("--timeout", 0) == 0)
+        {
+            if (!option_value(argc, argv, i, arg, 9, value) || !parse_seconds("--timeout", value, opts.timeout))
+                return false;
+        }
+        else if (arg.rfind("--cache-dir", 0) == 0)
+        {
+            if (!option_value(argc, argv, i, arg, 11, value))
+                return false;
+            opts.cache_dir = value;
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+
+    opts.context = has_after || has_before || has_context;
+    if (!has_after)
+        opts.after_context = context;
+    if (!has_before)
+        opts.before_context = context;
+
+    if (opts.index)
+    {
+        if (opts.paths.empty())
+        {
+            std::cerr << "Expected a directory to index" << std::endl;
+            return false;
+        }
+        return true;
+    }
+    if (!has_pattern)
+    {
+        std::cerr << "Expected a pattern" << std::endl;
+        return false;
+    }
+    if (opts.recursive && opts.paths.empty())
+    {
+        std::cerr << "Expected pattern and directory" << std::endl;
+        return false;
+    }
+    // followed files never end, so there is no total to report
+    if (opts.follow && (opts.recursive || opts.mode == PRINT_COUNT || opts.mode == PRINT_MATCHING ||
+                        opts.mode == PRINT_NON_MATCHING))
+    {
+        std::cerr << "--follow cannot be combined with -r, -c, -l or -L" << std::endl;
+        return false;
+    }
+    return true;
+}
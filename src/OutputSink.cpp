@@ -0,0 +1,54 @@
+#include "include/OutputSink.h"
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+OutputSink::OutputSink(int fd, size_t capacity) : _fd(fd), _buffer(capacity > 0 ? capacity : 1)
+{
+}
+
+OutputSink::~OutputSink()
+{
+    flush();
+}
+
+void OutputSink::write(const char *data, size_t size)
+{
+    if (size > _buffer.size() - _used)
+    {
+        flush();
+        // larger than the whole buffer: no point in copying it first
+        if (size >= _buffer.size())
+        {
+            write_all(data, size);
+            return;
+        }
+    }
+    std::memcpy(_buffer.data() + _used, data, size);
+    _used += size;
+}
+
+void OutputSink::flush()
+{
+    if (_used == 0)
+        return;
+    write_all(_buffer.data(), _used);
+    _used = 0;
+}
+
+void OutputSink::write_all(const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = ::write(_fd, data, size);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return; // reader went away (EPIPE) or similar; nothing useful left to do
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+}
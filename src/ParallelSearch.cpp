@@ -0,0 +1,300 @@
+#include "include/ParallelSearch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static size_t default_jobs(size_t jobs)
+{
+    if (jobs > 0)
+        return jobs;
+    size_t hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+ParallelSearch::ParallelSearch(const Options &opts, const PatternSet &patterns, OutputSink &sink)
+    : _sink(sink), _sort_files(opts.sort_files), _mode(opts.mode),
+      _splittable((opts.mode == PRINT_LINES || opts.mode == PRINT_COUNT) && opts.max_count == SIZE_MAX &&
+                  !opts.context),
+      _context(opts.mode == PRINT_LINES && opts.context),
+      _stats(opts.stats), _timeout(opts.timeout), _walker(opts),
+      _workers(default_jobs(opts.jobs)), _pool(_workers.size()),
+      _query(opts.no_index ? TrigramQuery() : TrigramQuery::from_patterns(opts.patterns)),
+      _use_index(_query.op != TrigramQuery::QUERY_ALL && opts.mode != PRINT_COUNT && opts.mode != PRINT_NON_MATCHING)
+{
+    for (auto &worker : _workers)
+    {
+        // the compiled patterns are read-only, so the caller's serve them all
+        worker.pattern = std::make_unique<PatternSet>(opts.patterns, &patterns);
+        worker.pattern->parse();
+        worker.scanner = std::make_unique<FileScanner>(*worker.pattern, &_sink);
+        worker.scanner->set_output(&worker.output);
+        worker.scanner->set_line_numbers(opts.line_numbers);
+        worker.scanner->set_mode(opts.mode);
+        if (opts.context)
+            worker.scanner->set_context(opts.after_context, opts.before_context);
+        worker.scanner->set_max_count(opts.max_count);
+        worker.scanner->set_cancel(&_cancel);
+        worker.scanner->set_skip_binary(!opts.text);
+        worker.scanner->set_limits(opts.max_steps, opts.timeout);
+        if (_stats)
+            worker.scanner->set_stats(&worker.stats);
+    }
+
+    if (opts.recursive && opts.io != IO_SYNC)
+    {
+        _reader = std::make_unique<AsyncReader>(opts.io, [this](ReadFile &&file)
+                                                { _pool.submit([this, file = std::move(file)](size_t worker) mutable
+                                                               {
+                                                                   scan_read(worker, file);
+                                                                   _reader->release(); }); });
+    }
+}
+
+void ParallelSearch::collect_stats(MatchStats &stats) const
+{
+    stats.merge(_chunked_stats);
+    for (const auto &worker : _workers)
+    {
+        MatchStats counted = worker.stats;
+        worker.pattern->collect_stats(counted);
+        stats.merge(counted);
+    }
+}
+
+bool ParallelSearch::search(const std::string &root)
+{
+    std::error_code ec;
+    if (fs::is_directory(root, ec))
+    {
+        TrigramIndex index;
+        if (_use_index && index.load(root))
+            index.select(_query);
+        _walker.walk(root, _sort_files, [this, &index](std::string path)
+                     {
+                         if (!index.excludes(path))
+                             submit(std::move(path)); }, &_cancel);
+    }
+    else
+    {
+        int fd = open(root.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && splits(static_cast<size_t>(st.st_size)))
+        {
+            bool found = search_large_file(fd, static_cast<size_t>(st.st_size), root, root);
+            close(fd);
+            return found;
+        }
+        if (fd >= 0)
+            close(fd);
+        submit(root);
+    }
+
+    // every file has to reach the pool before waiting on it means anything
+    if (_reader)
+        _reader->drain();
+    _pool.wait();
+    return _found;
+}
+
+bool ParallelSearch::search_large_file(int fd, size_t size, const std::string &label, const std::string &name)
+{
+    auto started = std::chrono::steady_clock::now();
+    void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        // unmappable after all: one worker streams it like any other file
+        bool found = false;
+        _pool.submit([&](size_t worker)
+                     {
+            Worker &w = _workers[worker];
+            w.output.clear();
+            found = w.scanner->scan_fd(fd, label, name);
+            std::lock_guard<std::mutex> guard(_output_lock);
+            _sink.write(w.output);
+            _sink.end_block(); });
+        _pool.wait();
+        return found;
+    }
+
+    // the deadline covers the whole file, whichever workers scan it
+    for (auto &worker : _workers)
+        worker.scanner->start_file(started);
+    ChunkedFile file{static_cast<const char *>(map), size, label, std::vector<Chunk>((size + chunk_size - 1) / chunk_size)};
+    for (size_t i = 0; i < _workers.size(); ++i)
+        _pool.submit([this, &file](size_t worker)
+                     { scan_chunks(worker, file); });
+    _pool.wait();
+    munmap(map, size);
+
+    uint64_t abandoned = 0;
+    bool timed_out = false;
+    for (const auto &worker : _workers)
+    {
+        abandoned += worker.scanner->abandoned();
+        timed_out |= worker.scanner->timed_out();
+    }
+    FileScanner::report_limits(name.empty() ? label : name, abandoned, timed_out, _timeout);
+
+    if (_stats)
+    {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        _chunked_stats.files.push_back({name.empty() ? label : name, size, file.lines_before, file.matched, elapsed.count()});
+    }
+
+    if (_mode == PRINT_COUNT)
+    {
+        std::string count = std::to_string(file.matched.load());
+        _sink.write(label.empty() ? count : label + ":" + count);
+        _sink.end_line();
+    }
+    return file.found;
+}
+
+// Chunk i covers [boundary(i * chunk_size), boundary((i + 1) * chunk_size)):
+// a nominal offset moves forward to the next line start, so neighbouring
+// chunks agree on their common boundary without talking to each other.
+size_t ParallelSearch::chunk_boundary(const ChunkedFile &file, size_t offset)
+{
+    if (offset == 0 || offset >= file.size)
+        return std::min(offset, file.size);
+    const void *newline = memchr(file.data + offset - 1, '\n', file.size - offset + 1);
+    return newline ? static_cast<size_t>(static_cast<const char *>(newline) - file.data) + 1 : file.size;
+}
+
+void ParallelSearch::scan_chunks(size_t worker, ChunkedFile &file)
+{
+    FileScanner &scanner = *_workers[worker].scanner;
+    for (size_t i; (i = file.next_chunk++) < file.chunks.size();)
+    {
+        Chunk &chunk = file.chunks[i];
+        size_t begin = chunk_boundary(file, i * chunk_size);
+        size_t end = chunk_boundary(file, (i + 1) * chunk_size);
+
+        scanner.set_hits(&chunk.hits);
+        scanner.reset_counts();
+        if (begin < end && scanner.scan_buffer(file.data + begin, file.data + end, file.label))
+            file.found = true;
+        file.matched += scanner.matched();
+        chunk.lines = scanner.lines();
+        scanner.set_hits(nullptr);
+
+        publish_chunk(file, i);
+    }
+}
+
+void ParallelSearch::publish_chunk(ChunkedFile &file, size_t index)
+{
+    std::lock_guard<std::mutex> guard(_output_lock);
+    file.chunks[index].done = true;
+    for (; file.next_to_emit < file.chunks.size() && file.chunks[file.next_to_emit].done; ++file.next_to_emit)
+    {
+        Chunk &chunk = file.chunks[file.next_to_emit];
+        for (const LineHit &hit : chunk.hits)
+            FileScanner::write_line(_sink, file.label, hit.line > 0 ? file.lines_before + hit.line : 0, hit.begin, hit.end);
+        file.lines_before += chunk.lines;
+        std::vector<LineHit>().swap(chunk.hits);
+    }
+    _sink.end_block();
+}
+
+void ParallelSearch::submit(std::string path)
+{
+    size_t sequence = _next_sequence++;
+    if (_reader)
+    {
+        _reader->submit(sequence, std::move(path));
+        return;
+    }
+    _pool.submit([this, sequence, path = std::move(path)](size_t worker)
+                 { scan(worker, sequence, path); });
+}
+
+void ParallelSearch::scan(size_t worker, size_t sequence, const std::string &path)
+{
+    ReadFile file;
+    file.sequence = sequence;
+    file.path = path;
+    // after a -q hit the queued files are not even opened
+    if (!_cancel)
+    {
+        file.fd = open(path.c_str(), O_RDONLY);
+        if (file.fd < 0)
+            file.error = errno;
+    }
+    scan_read(worker, file);
+}
+
+void ParallelSearch::scan_read(size_t worker, ReadFile &file)
+{
+    Worker &w = _workers[worker];
+    w.output.clear();
+
+    // after a -q hit the files still queued are skipped
+    if (!_cancel && file.error)
+        std::cerr << "Failed to open file: " << file.path << std::endl;
+    else if (!_cancel)
+    {
+        w.scanner->reset_context();
+        bool found = file.fd >= 0 ? w.scanner->scan_fd(file.fd, file.path)
+                                  : w.scanner->scan_data(file.data.data(), file.data.size(), file.path);
+        if (found)
+        {
+            _found = true;
+            if (_mode == PRINT_NOTHING)
+                _cancel = true;
+        }
+    }
+    if (file.fd >= 0)
+        close(file.fd);
+    publish(file.sequence, w.output);
+}
+
+void ParallelSearch::publish(size_t sequence, std::string &text)
+{
+    std::lock_guard<std::mutex> guard(_output_lock);
+    if (!_sort_files)
+    {
+        write_file_output(text);
+        _sink.end_block();
+        return;
+    }
+
+    // files finishing early wait until every file before them has been written
+    if (sequence != _next_to_emit)
+    {
+        _ready.emplace(sequence, std::move(text));
+        return;
+    }
+    write_file_output(text);
+    ++_next_to_emit;
+    for (auto it = _ready.begin(); it != _ready.end() && it->first == _next_to_emit; it = _ready.erase(it))
+    {
+        write_file_output(it->second);
+        ++_next_to_emit;
+    }
+    _sink.end_block();
+}
+
+void ParallelSearch::write_file_output(const std::string &text)
+{
+    if (text.empty())
+        return;
+    // each worker starts every file as if it were the first, so the "--"
+    // between the context groups of different files is added here
+    if (_context && _wrote_context)
+    {
+        _sink.write("--");
+        _sink.end_line();
+    }
+    _wrote_context = true;
+    _sink.write(text);
+}
@@ -0,0 +1,298 @@
+#include "include/Pattern.h"
+#include "include/Backtracker.h"
+#include "include/CompiledPattern.h"
+#include "include/LazyDfa.h"
+#include "include/PikeVm.h"
+#include "include/Prefilter.h"
+#include "include/RegParser.h"
+
+#include <algorithm>
+#include <cstring>
+
+struct Pattern::Impl
+{
+    std::string source;
+    CompiledPattern compiled;
+    Nfa lean;    // the program without the captures only find() reads
+    Nfa relaxed; // backreference patterns: lean with Nfa::relax_backrefs
+    std::unique_ptr<const Prefilter> prefilter; // set when every match must contain a known literal
+    bool literal_only = false; // the prefilter literal is the whole pattern, so hits need no engine
+};
+
+// Patterns without BACKREF get the DFA and the PikeVm (which only runs for
+// find()), the others the Backtracker, behind a DFA for the program with its
+// backreferences relaxed. Only the PikeVm and tracer keep the captures
+// nothing but find() reads.
+struct Matcher::Engines
+{
+    std::unique_ptr<LazyDfa> dfa;
+    std::unique_ptr<PikeVm> pike;
+    std::unique_ptr<Backtracker> backtracker;
+    std::unique_ptr<Backtracker> tracer; // find() on backreference patterns; built on first use
+    std::unique_ptr<LazyDfa> approx;
+    std::vector<size_t> slots;
+    MatchLimits limits;
+    uint64_t abandoned = 0;
+    uint64_t candidates = 0; // lines containing the prefilter literal
+    uint64_t confirmed = 0;  // of those, lines that matched
+
+    // matches one line of a buffer in place
+    bool match_line(const char *begin, const char *end);
+};
+
+std::shared_ptr<const Pattern> Pattern::compile(const std::string &source)
+{
+    RegParser parser(source);
+    return parser.pattern();
+}
+
+Pattern::Pattern(std::string source, CompiledPattern compiled)
+{
+    auto impl = std::make_unique<Impl>();
+    impl->source = std::move(source);
+    impl->compiled = std::move(compiled);
+    impl->lean = impl->compiled.program;
+
+    // only find() reports group spans; everything else runs without the
+    // captures that no backreference reads
+    impl->lean.drop_captures();
+
+    // backreferences are not regular; those patterns run on the backtracker
+    if (impl->lean.has_backrefs)
+    {
+        impl->relaxed = impl->lean;
+        impl->relaxed.relax_backrefs();
+    }
+
+    auto prefilter = std::make_unique<Prefilter>();
+    if (prefilter->build(impl->compiled.required))
+        impl->prefilter = std::move(prefilter);
+
+    // the prefilter searches for the whole pattern, so every hit is a match
+    const std::string &literal = impl->compiled.literal;
+    impl->literal_only = impl->prefilter && literal == impl->compiled.required && literal.find('\n') == std::string::npos;
+    _impl = std::move(impl);
+}
+
+Pattern::~Pattern() = default;
+
+const std::string &Pattern::source() const
+{
+    return _impl->source;
+}
+
+const CompiledPattern &Pattern::compiled() const
+{
+    return _impl->compiled;
+}
+
+size_t Pattern::group_count() const
+{
+    return static_cast<size_t>(_impl->compiled.groups);
+}
+
+bool Pattern::uses_dfa() const
+{
+    return !_impl->compiled.program.has_backrefs;
+}
+
+Matcher::Matcher(std::shared_ptr<const Pattern> pattern)
+    : _pattern(std::move(pattern)), _engines(std::make_unique<Engines>())
+{
+    const Pattern::Impl &impl = *_pattern->_impl;
+    if (!_pattern->uses_dfa())
+    {
+        _engines->approx = std::make_unique<LazyDfa>(impl.relaxed);
+        _engines->backtracker = std::make_unique<Backtracker>(impl.lean);
+    }
+    else
+    {
+        _engines->pike = std::make_unique<PikeVm>(impl.compiled.program);
+        _engines->dfa = std::make_unique<LazyDfa>(impl.lean);
+    }
+}
+
+Matcher::~Matcher() = default;
+
+uint64_t Matcher::abandoned() const
+{
+    return _engines->abandoned;
+}
+
+bool Matcher::expired() const
+{
+    const Engines &e = *_engines;
+    return (e.backtracker && e.backtracker->expired()) || (e.tracer && e.tracer->expired());
+}
+
+EngineStats Matcher::stats() const
+{
+    const Pattern::Impl &p = *_pattern->_impl;
+    const Engines &e = *_engines;
+    EngineStats stats;
+    stats.engine = e.dfa ? "dfa" : "backtrack";
+    stats.patterns = p.source;
+    if (p.prefilter)
+        stats.prefilter = p.prefilter->literal();
+    stats.candidates = e.candidates;
+    stats.confirmed = e.confirmed;
+    if (e.dfa)
+    {
+        stats.states = e.dfa->states_built();
+        stats.flushes = e.dfa->flushes();
+    }
+    if (e.backtracker)
+    {
+        stats.steps = e.backtracker->steps() + (e.tracer ? e.tracer->steps() : 0);
+        stats.states = e.approx->states_built();
+        stats.flushes = e.approx->flushes();
+    }
+    stats.abandoned = e.abandoned;
+    return stats;
+}
+
+void Matcher::set_limits(const MatchLimits &limits)
+{
+    Engines &e = *_engines;
+    e.limits = limits;
+    if (e.backtracker)
+        e.backtracker->set_limits(limits);
+    if (e.tracer)
+        e.tracer->set_limits(limits);
+}
+
+bool Matcher::match(std::string_view line)
+{
+    const Pattern::Impl &p = *_pattern->_impl;
+    Engines &e = *_engines;
+    if (p.compiled.empty)
+        return false;
+
+    const char *begin = line.data();
+    const char *end = begin + line.size();
+    if (!p.prefilter)
+        return e.match_line(begin, end);
+    if (!p.prefilter->find(begin, end))
+        return false;
+    ++e.candidates;
+    bool matched = p.literal_only || e.match_line(begin, end);
+    e.confirmed += matched;
+    return matched;
+}
+
+bool Matcher::find(std::string_view line, size_t start, MatchResult &result)
+{
+    const Pattern::Impl &p = *_pattern->_impl;
+    Engines &e = *_engines;
+    result.groups.assign(_pattern->group_count() + 1, MatchSpan{});
+    if (p.compiled.empty || start > line.size())
+        return false;
+
+    const char *begin = line.data();
+    const char *end = begin + line.size();
+    if (p.prefilter && !p.prefilter->find(begin + start, end))
+        return false;
+
+    if (e.pike)
+    {
+        // the DFA rejects most lines far faster than the VM can locate a match;
+        // treating begin + start as a line start can only let more lines through
+        if (!e.dfa->match(begin + start, end) || !e.pike->search(line, start, e.slots))
+            return false;
+    }
+    else
+    {
+        if (!e.approx->match(begin + start, end))
+            return false;
+        if (!e.tracer)
+        {
+            e.tracer = std::make_unique<Backtracker>(p.compiled.program);
+            e.tracer->set_limits(e.limits);
+        }
+        if (!e.tracer->search(line, start, e.slots))
+        {
+            e.abandoned += e.tracer->gave_up() && !e.tracer->expired();
+            return false;
+        }
+    }
+
+    size_t groups = std::min(result.groups.size(), e.slots.size() / 2);
+    for (size_t i = 0; i < groups; ++i)
+    {
+        // a group inside a failed iteration may have only one end recorded
+        if (e.slots[2 * i] != std::string_view::npos && e.slots[2 * i + 1] != std::string_view::npos)
+            result.groups[i] = {e.slots[2 * i], e.slots[2 * i + 1]};
+    }
+    return true;
+}
+
+bool Matcher::Engines::match_line(const char *begin, const char *end)
+{
+    if (dfa)
+        return dfa->match(begin, end);
+    if (!approx->match(begin, end))
+        return false;
+    if (backtracker->search(std::string_view(begin, static_cast<size_t>(end - begin)), 0, slots))
+        return true;
+    abandoned += backtracker->gave_up() && !backtracker->expired();
+    return false;
+}
+
+const char *Matcher::find_line(const char *begin, const char *end)
+{
+    const Pattern::Impl &p = *_pattern->_impl;
+    Engines &e = *_engines;
+    if (p.compiled.empty)
+        return nullptr;
+
+    if (const Prefilter *prefilter = p.prefilter.get())
+    {
+        // only lines containing the required literal reach an engine
+        const char *pos = begin;
+        while (pos < end && !expired())
+        {
+            const char *hit = prefilter->find(pos, end);
+            if (!hit)
+                return nullptr;
+
+            const char *prev_newline = static_cast<const char *>(memrchr(pos, '\n', static_cast<size_t>(hit - pos)));
+            const char *line = prev_newline ? prev_newline + 1 : pos;
+            const char *line_end = static_cast<const char *>(memchr(hit, '\n', static_cast<size_t>(end - hit)));
+            if (!line_end)
+                line_end = end;
+
+            ++e.candidates;
+            if (p.literal_only || e.match_line(line, line_end))
+            {
+                ++e.confirmed;
+                return line;
+            }
+            pos = line_end + 1;
+        }
+        return nullptr;
+    }
+
+    if (e.dfa)
+        return e.dfa->find_line(begin, end);
+
+    // the relaxed DFA skips to the lines that may match; only those are backtracked
+    const char *line = begin;
+    while (line < end && !expired())
+    {
+        const char *hit = e.approx->find_line(line, end);
+        if (!hit)
+            return nullptr;
+        const char *prev_newline = static_cast<const char *>(memrchr(line, '\n', static_cast<size_t>(hit - line)));
+        if (prev_newline)
+            line = prev_newline + 1;
+        const char *line_end = static_cast<const char *>(memchr(hit, '\n', static_cast<size_t>(end - hit)));
+        if (!line_end)
+            line_end = end;
+
+        if (e.backtracker->search(std::string_view(line, static_cast<size_t>(line_end - line)), 0, e.slots))
+            return line;
+        e.abandoned += e.backtracker->gave_up() && !e.backtracker->expired();
+        line = line_end + 1;
+    }
+    return nullptr;
+}
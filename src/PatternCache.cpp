@@ -0,0 +1,176 @@
+#include "include/PatternCache.h"
+#include "include/BinaryFile.h"
+#include "include/RegParser.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr uint32_t magic = 0x43435052; // "RPCC"
+static constexpr uint32_t byte_order = 0x01020304;
+
+enum
+{
+    ENTRY_EMPTY = 1,
+    ENTRY_BACKREFS = 2,
+};
+
+// a damaged or foreign file must not hand the engines an index out of range
+static bool valid_program(const Nfa &nfa)
+{
+    int states = static_cast<int>(nfa.states.size());
+    auto valid_state = [states](int id)
+    { return id >= -1 && id < states; };
+    if (nfa.start < 0 || nfa.start >= states || nfa.slot_count < 2)
+        return false;
+    for (const NfaState &st : nfa.states)
+    {
+        if (st.op < NFA_BYTE || st.op > NFA_MATCH || !valid_state(st.out) || !valid_state(st.out1))
+            return false;
+        if (st.op == NFA_BYTE && (st.set < 0 || st.set >= static_cast<int>(nfa.sets.size())))
+            return false;
+        if ((st.op == NFA_SAVE || st.op == NFA_PROGRESS) && (st.slot < 0 || st.slot >= nfa.slot_count))
+            return false;
+        if (st.op == NFA_BACKREF && (st.slot < 0 || 2 * st.slot + 1 >= nfa.slot_count))
+            return false;
+    }
+    return true;
+}
+
+static bool read_pattern(BinaryReader &in, CompiledPattern &compiled)
+{
+    uint32_t flags = in.u32();
+    compiled.groups = in.i32();
+    compiled.program.start = in.i32();
+    compiled.program.slot_count = in.i32();
+    uint32_t states = in.u32();
+    uint32_t sets = in.u32();
+    uint32_t required = in.u32();
+    uint32_t literal = in.u32();
+    // each state takes 20 bytes and each set 32, so larger counts cannot fit
+    if (!in.ok || states > static_cast<size_t>(in.end - in.pos) / 20 || sets > static_cast<size_t>(in.end - in.pos) / 32)
+        return false;
+
+    compiled.empty = flags & ENTRY_EMPTY;
+    compiled.program.has_backrefs = flags & ENTRY_BACKREFS;
+    compiled.program.states.resize(states);
+    for (NfaState &st : compiled.program.states)
+    {
+        st.op = static_cast<NfaOp>(in.i32());
+        st.out = in.i32();
+        st.out1 = in.i32();
+        st.set = in.i32();
+        st.slot = in.i32();
+    }
+    compiled.program.sets.resize(sets);
+    for (CharSet &set : compiled.program.sets)
+        in.bytes(set.bits, sizeof(set.bits));
+    compiled.required = in.string(required);
+    compiled.literal = in.string(literal);
+    return in.ok && compiled.groups >= 0 && valid_program(compiled.program);
+}
+
+static void write_pattern(BinaryWriter &out, const CompiledPattern &compiled)
+{
+    const Nfa &program = compiled.program;
+    out.u32((compiled.empty ? ENTRY_EMPTY : 0) | (program.has_backrefs ? ENTRY_BACKREFS : 0));
+    out.i32(compiled.groups);
+    out.i32(program.start);
+    out.i32(program.slot_count);
+    out.u32(static_cast<uint32_t>(program.states.size()));
+    out.u32(static_cast<uint32_t>(program.sets.size()));
+    out.u32(static_cast<uint32_t>(compiled.required.size()));
+    out.u32(static_cast<uint32_t>(compiled.literal.size()));
+    for (const NfaState &st : program.states)
+    {
+        out.i32(st.op);
+        out.i32(st.out);
+        out.i32(st.out1);
+        out.i32(st.set);
+        out.i32(st.slot);
+    }
+    for (const CharSet &set : program.sets)
+        out.bytes(set.bits, sizeof(set.bits));
+    out.bytes(compiled.required.data(), compiled.required.size());
+    out.bytes(compiled.literal.data(), compiled.literal.size());
+}
+
+PatternCache::PatternCache(std::string dir) : _dir(std::move(dir))
+{
+}
+
+// length-prefixed, so no pattern text can make two lists look alike
+std::string PatternCache::key(const std::vector<std::string> &patterns)
+{
+    std::string key;
+    for (const auto &pattern : patterns)
+    {
+        key += std::to_string(pattern.size());
+        key += ':';
+        key += pattern;
+    }
+    return key;
+}
+
+// 64-bit FNV-1a of the key
+std::string PatternCache::path(const std::string &key) const
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : key)
+    {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.rpc", static_cast<unsigned long long>(hash));
+    return _dir + "/" + name;
+}
+
+bool PatternCache::load(const std::vector<std::string> &patterns, std::vector<CompiledPattern> &compiled) const
+{
+    std::string k = key(patterns);
+    int fd = open(path(k).c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    BinaryReader in{static_cast<const char *>(data), static_cast<const char *>(data) + st.st_size};
+    bool ok = in.u32() == magic && in.u32() == format_version && in.u32() == byte_order;
+    ok = ok && in.string(in.u32()) == k && in.u32() == patterns.size();
+    compiled.clear();
+    compiled.resize(ok ? patterns.size() : 0);
+    for (size_t i = 0; ok && i < compiled.size(); ++i)
+        ok = read_pattern(in, compiled[i]);
+    munmap(data, static_cast<size_t>(st.st_size));
+    if (!ok)
+        compiled.clear();
+    return ok;
+}
+
+bool PatternCache::store(const std::vector<std::string> &patterns,
+                         const std::vector<const CompiledPattern *> &compiled) const
+{
+    std::string k = key(patterns);
+    BinaryWriter out;
+    out.u32(magic);
+    out.u32(format_version);
+    out.u32(byte_order);
+    out.u32(static_cast<uint32_t>(k.size()));
+    out.bytes(k.data(), k.size());
+    out.u32(static_cast<uint32_t>(compiled.size()));
+    for (const CompiledPattern *pattern : compiled)
+        write_pattern(out, *pattern);
+
+    std::error_code ec;
+    std::filesystem::create_directories(_dir, ec);
+    return replace_file(path(k), out.out);
+}
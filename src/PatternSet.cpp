@@ -0,0 +1,249 @@
+#include "include/PatternSet.h"
+#include "include/CompiledPattern.h"
+#include "include/LazyDfa.h"
+#include "include/Nfa.h"
+#include "include/PatternCache.h"
+
+#include <cstring>
+
+PatternSet::PatternSet(const std::vector<std::string> &patterns, const PatternSet *shared)
+    : _sources(patterns), _shared(shared)
+{
+}
+
+PatternSet::~PatternSet() = default;
+
+bool PatternSet::compile()
+{
+    if (_shared)
+    {
+        _compiled = _shared->_compiled;
+        _literals = _shared->_literals;
+        return true;
+    }
+
+    std::vector<CompiledPattern> cached;
+    bool from_cache = _cache && _cache->load(_sources, cached);
+    for (size_t i = 0; i < _sources.size(); ++i)
+    {
+        const std::string &source = _sources[i];
+        auto pattern = from_cache ? std::make_shared<const Pattern>(source, std::move(cached[i]))
+                                  : Pattern::compile(source);
+        if (!pattern)
+        {
+            _invalid = source;
+            return false;
+        }
+        _compiled.push_back(std::move(pattern));
+    }
+
+    if (_cache && !from_cache)
+    {
+        std::vector<const CompiledPattern *> compiled;
+        for (const auto &pattern : _compiled)
+            compiled.push_back(&pattern->compiled());
+        _cache->store(_sources, compiled);
+    }
+    return true;
+}
+
+bool PatternSet::parse()
+{
+    if (_parsed)
+        return _valid;
+    _parsed = true;
+
+    if (!compile())
+        return false;
+
+    std::vector<std::string> literals;
+    std::vector<Matcher *> literal_patterns;
+    std::vector<Matcher *> regular;
+    for (const auto &compiled : _compiled)
+    {
+        auto pattern = std::make_unique<Matcher>(compiled);
+        pattern->set_limits(_limits);
+        Matcher *parsed = pattern.get();
+        _patterns.push_back(std::move(pattern));
+
+        // an empty pattern never matches, as with a single RegParser
+        if (compiled->compiled().empty)
+            continue;
+
+        const std::string &literal = compiled->compiled().literal;
+        if (!literal.empty())
+        {
+            literals.push_back(literal);
+            literal_patterns.push_back(parsed);
+        }
+        else if (compiled->uses_dfa())
+            regular.push_back(parsed);
+        else
+            _engines.push_back({ENGINE_PATTERN, 1, parsed});
+    }
+
+    // a lone literal is faster on the SIMD prefilter of its own Matcher
+    if (literals.size() >= 2)
+    {
+        if (!_literals)
+            _literals = std::make_shared<const AhoCorasick>(literals);
+        _engines.push_back({ENGINE_LITERALS, literals.size()});
+    }
+    else
+        regular.insert(regular.end(), literal_patterns.begin(), literal_patterns.end());
+
+    if (regular.size() == 1)
+        _engines.push_back({ENGINE_PATTERN, 1, regular[0]});
+    else if (regular.size() > 1)
+    {
+        std::vector<const Nfa *> programs;
+        for (Matcher *pattern : regular)
+            programs.push_back(&pattern->pattern().compiled().program);
+        Nfa nfa;
+        if (nfa.merge(programs))
+        {
+            nfa.drop_captures();
+            _dfa = std::make_unique<LazyDfa>(std::move(nfa));
+            _engines.push_back({ENGINE_DFA, regular.size()});
+        }
+        else
+        {
+            for (Matcher *pattern : regular)
+                _engines.push_back({ENGINE_PATTERN, 1, pattern});
+        }
+    }
+
+    _valid = true;
+    return true;
+}
+
+void PatternSet::set_limits(const MatchLimits &limits)
+{
+    _limits = limits;
+    for (const auto &pattern : _patterns)
+        pattern->set_limits(limits);
+}
+
+uint64_t PatternSet::abandoned() const
+{
+    uint64_t lines = 0;
+    for (const auto &pattern : _patterns)
+        lines += pattern->abandoned();
+    return lines;
+}
+
+bool PatternSet::expired() const
+{
+    for (const auto &pattern : _patterns)
+    {
+        if (pattern->expired())
+            return true;
+    }
+    return false;
+}
+
+void PatternSet::collect_stats(MatchStats &stats) const
+{
+    for (const Engine &engine : _engines)
+    {
+        if (engine.kind == ENGINE_PATTERN)
+        {
+            stats.engines.push_back(engine.pattern->stats());
+            continue;
+        }
+        EngineStats e;
+        e.patterns = std::to_string(engine.patterns) + " patterns";
+        if (engine.kind == ENGINE_LITERALS)
+        {
+            e.engine = "aho-corasick";
+            e.states = _literals->state_count();
+        }
+        else
+        {
+            e.engine = "union dfa";
+            e.states = _dfa->states_built();
+            e.flushes = _dfa->flushes();
+        }
+        stats.engines.push_back(e);
+    }
+}
+
+bool PatternSet::match(std::string_view line)
+{
+    if (!parse())
+        return false;
+
+    const char *begin = line.data();
+    const char *end = begin + line.size();
+    for (const Engine &engine : _engines)
+    {
+        switch (engine.kind)
+        {
+        case ENGINE_LITERALS:
+            if (_literals->find(begin, end))
+                return true;
+            break;
+        case ENGINE_DFA:
+            if (_dfa->match(begin, end))
+                return true;
+            break;
+        case ENGINE_PATTERN:
+            if (engine.pattern->match(line))
+                return true;
+            break;
+        }
+    }
+    return false;
+}
+
+const char *PatternSet::engine_find(Engine &engine, const char *begin, const char *end)
+{
+    switch (engine.kind)
+    {
+    case ENGINE_LITERALS:
+        return _literals->find(begin, end);
+    case ENGINE_DFA:
+        return _dfa->find_line(begin, end);
+    case ENGINE_PATTERN:
+    default:
+        return engine.pattern->find_line(begin, end);
+    }
+}
+
+void PatternSet::reset()
+{
+    for (auto &engine : _engines)
+        engine.searched = false;
+}
+
+// Every engine keeps the line of its next hit, so with several engines each
+// one still scans every byte of the buffer at most once: it only runs again
+// after the caller has moved past that line.
+const char *PatternSet::find_line(const char *begin, const char *end)
+{
+    if (!parse() || _engines.empty())
+        return nullptr;
+    if (_engines.size() == 1)
+        return engine_find(_engines[0], begin, end);
+
+    const char *best = nullptr;
+    for (auto &engine : _engines)
+    {
+        if (!engine.searched || (engine.next && engine.next < begin))
+        {
+            engine.searched = true;
+            engine.next = engine_find(engine, begin, end);
+            if (engine.next)
+            {
+                // any pointer into the line will do for the caller, but the
+                // cache compares line starts
+                const char *newline = static_cast<const char *>(
+                    memrchr(begin, '\n', static_cast<size_t>(engine.next - begin)));
+                engine.next = newline ? newline + 1 : begin;
+            }
+        }
+        if (engine.next && (!best || engine.next < best))
+            best = engine.next;
+    }
+    return best;
+}
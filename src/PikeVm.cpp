@@ -0,0 +1,117 @@
+#include "include/PikeVm.h"
+
+#include <algorithm>
+
+static constexpr size_t npos = std::string_view::npos;
+
+PikeVm::PikeVm(Nfa nfa) : _nfa(std::move(nfa)), _slot_count(static_cast<size_t>(_nfa.slot_count))
+{
+    size_t states = _nfa.states.size();
+    for (ThreadList *list : {&_clist, &_nlist})
+    {
+        list->dense.reserve(states);
+        list->sparse.assign(states, 0);
+        list->slots.assign(states * _slot_count, npos);
+    }
+    _scratch.assign(_slot_count, npos);
+}
+
+bool PikeVm::ThreadList::contains(int id) const
+{
+    int i = sparse[id];
+    return i < static_cast<int>(dense.size()) && dense[i] == id;
+}
+
+void PikeVm::ThreadList::insert(int id)
+{
+    sparse[id] = static_cast<int>(dense.size());
+    dense.push_back(id);
+}
+
+// Follows the epsilon edges from id in priority order. Every state reached is
+// added once; consuming states and MATCH keep a copy of the slots as they
+// were on the first (highest priority) path that reached them.
+void PikeVm::add_thread(ThreadList &list, int id, std::string_view text, size_t pos)
+{
+    _stack.push_back({id, -1, 0});
+    while (!_stack.empty())
+    {
+        Frame frame = _stack.back();
+        _stack.pop_back();
+        if (frame.slot >= 0)
+        {
+            _scratch[frame.slot] = frame.value;
+            continue;
+        }
+        if (frame.id < 0 || list.contains(frame.id))
+            continue;
+        list.insert(frame.id);
+
+        const NfaState &st = _nfa.states[frame.id];
+        switch (st.op)
+        {
+        case NFA_SPLIT:
+            _stack.push_back({st.out1, -1, 0});
+            _stack.push_back({st.out, -1, 0});
+            break;
+        case NFA_BOL:
+            if (pos == 0)
+                _stack.push_back({st.out, -1, 0});
+            break;
+        case NFA_EOL:
+            if (pos == text.size())
+                _stack.push_back({st.out, -1, 0});
+            break;
+        case NFA_SAVE:
+            _stack.push_back({-1, st.slot, _scratch[st.slot]});
+            _scratch[st.slot] = pos;
+            _stack.push_back({st.out, -1, 0});
+            break;
+        case NFA_PROGRESS:
+            _stack.push_back({_scratch[st.slot] != pos ? st.out : st.out1, -1, 0});
+            break;
+        default:
+            std::copy(_scratch.begin(), _scratch.end(), list.slots.begin() + frame.id * _slot_count);
+            break;
+        }
+    }
+}
+
+bool PikeVm::search(std::string_view text, size_t start, std::vector<size_t> &slots)
+{
+    bool matched = false;
+    _clist.clear();
+    for (size_t pos = start; pos <= text.size(); ++pos)
+    {
+        // a new attempt starting here ranks below every thread already running
+        if (!matched)
+        {
+            std::fill(_scratch.begin(), _scratch.end(), npos);
+            add_thread(_clist, _nfa.start, text, pos);
+        }
+        if (_clist.dense.empty())
+            break;
+
+        _nlist.clear();
+        for (int id : _clist.dense)
+        {
+            const NfaState &st = _nfa.states[id];
+            const size_t *thread_slots = _clist.slots.data() + id * _slot_count;
+            if (st.op == NFA_MATCH)
+            {
+                // lower priority threads can only produce less preferred matches
+                slots.assign(thread_slots, thread_slots + _slot_count);
+                matched = true;
+                break;
+            }
+            if (st.op == NFA_BYTE && pos < text.size() &&
+                _nfa.sets[st.set].test(static_cast<unsigned char>(text[pos])))
+            {
+                std::copy(thread_slots, thread_slots + _slot_count, _scratch.begin());
+                add_thread(_nlist, st.out, text, pos + 1);
+            }
+        }
+        std::swap(_clist, _nlist);
+    }
+    return matched;
+}
@@ -0,0 +1,98 @@
+#include "include/Prefilter.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define PREFILTER_HAVE_AVX2
+#endif
+
+static const char *find_scalar(const char *haystack, size_t n, const char *needle, size_t k)
+{
+    if (k == 1)
+        return static_cast<const char *>(memchr(haystack, needle[0], n));
+    return static_cast<const char *>(memmem(haystack, n, needle, k));
+}
+
+#if defined(__SSE2__)
+// Compares the first and last byte of the needle against 16 candidate
+// positions at once and only verifies positions where both agree.
+static const char *find_sse2(const char *haystack, size_t n, const char *needle, size_t k)
+{
+    if (k == 1 || n < k + 16)
+        return find_scalar(haystack, n, needle, k);
+
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[k - 1]);
+    size_t i = 0;
+    for (; i + k - 1 + 16 <= n; i += 16)
+    {
+        __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(haystack + i));
+        __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i *>(haystack + i + k - 1));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last))));
+        while (mask)
+        {
+            unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+            if (memcmp(haystack + i + bit + 1, needle + 1, k - 2) == 0)
+                return haystack + i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return find_scalar(haystack + i, n - i, needle, k);
+}
+#endif
+
+#ifdef PREFILTER_HAVE_AVX2
+__attribute__((target("avx2"))) static const char *find_avx2(const char *haystack, size_t n, const char *needle, size_t k)
+{
+    if (k == 1 || n < k + 32)
+        return find_scalar(haystack, n, needle, k);
+
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[k - 1]);
+    size_t i = 0;
+    for (; i + k - 1 + 32 <= n; i += 32)
+    {
+        __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(haystack + i));
+        __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(haystack + i + k - 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last))));
+        while (mask)
+        {
+            unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+            if (memcmp(haystack + i + bit + 1, needle + 1, k - 2) == 0)
+                return haystack + i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return find_scalar(haystack + i, n - i, needle, k);
+}
+#endif
+
+bool Prefilter::build(const std::string &literal)
+{
+    _literal = literal;
+    if (_literal.empty())
+        return false;
+
+    _find = find_scalar;
+#if defined(__SSE2__)
+    _find = find_sse2;
+#endif
+#ifdef PREFILTER_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        _find = find_avx2;
+#endif
+    return true;
+}
+
+const char *Prefilter::find(const char *begin, const char *end) const
+{
+    if (begin >= end)
+        return nullptr;
+    return _find(begin, static_cast<size_t>(end - begin), _literal.data(), _literal.size());
+}
@@ -1,6 +1,11 @@
 #include "include/RegParser.h"
+#include "include/Optimizer.h"
+#include "include/Prefilter.h"
+
+#include <algorithm>
 
 #ifdef DEBUG
+#include <iostream>
 
 void printQuantifier(const Re &re)
 {
@@ -21,9 +26,19 @@ void printQuantifier(const Re &re)
         std::cout << "*";
         break;
     }
+    case REPEAT:
+    {
+        std::cout << "{" << re.repeat_min << ",";
+        if (re.repeat_max >= 0)
+            std::cout << re.repeat_max;
+        std::cout << "}";
+        break;
+    }
     default:
         break;
     }
+    if (re.lazy)
+        std::cout << "?";
 }
 
 void printDebug(const std::vector<Re> &reList)
@@ -75,6 +90,11 @@ void printDebug(const std::vector<Re> &reList)
             std::cout << std::endl;
             break;
         }
+        case STRING:
+        {
+            std::cout << "STRING" << " >> " << tmp.ccl << std::endl;
+            break;
+        }
         case LIST:
         {
             std::cout << (tmp.isNegative ? "NEGATIVE " : "POSITIVE ") << "LIST" << " >> " << tmp.ccl;
@@ -102,7 +122,7 @@ void printDebug(const std::vector<Re> &reList)
 }
 #endif
 
-bool RegParser::parse()
+bool RegParser::parse_tokens()
 {
     if (!_pattern)
         return false;
@@ -128,448 +148,123 @@ bool RegParser::parse()
     }
 
     parser_gp_stack.pop();
-    return true;
-}
-
-bool RegParser::match(const std::string &input_line)
-{
-    if (!parse())
-        return false;
-
-    const auto &regex = token_list.regex;
 #ifdef DEBUG
-    printDebug(regex);
+    printDebug(token_list.regex);
 #endif
-    if (regex.empty())
-        return false;
-
-    const char *c = input_line.c_str();
-    bool has_start_anchor = regex[0].type == START;
-
-    if (has_start_anchor)
-    {
-        sync_index(&token_list, 1);
-        return match_from_position(&c, token_list, 1);
-    }
-    else
-    {
-        while (*c != '\0')
-        {
-            sync_index(&token_list, 0);
-            if (match_from_position(&c, token_list, 0))
-                return true;
-            ++c;
-        }
-        return false;
-    }
-}
-bool RegParser::match_current(const char *c, const std::vector<Re> &regex, int idx)
-{
-    const Re &current = regex[idx];
-
-    switch (current.type)
-    {
-    case DIGIT:
-        return isdigit(*c);
-    case ALPHANUM:
-        return isalnum(*c) || *c == '_';
-    case SINGLE_CHAR:
-        return *c == current.ccl[0] || current.ccl[0] == '.';
-    case LIST:
-        return matchCharacterInList(*c, current);
-    case START:
-        return true;
-    case END:
-        return *c == '\0';
-    default:
-        return false;
-    }
+    return true;
 }
 
-bool RegParser::matchCharacterInList(char c, const Re &listRe) const
+std::shared_ptr<const Pattern> RegParser::pattern()
 {
-    for (char ch : listRe.ccl)
-    {
-        if (c == ch)
-            return !listRe.isNegative;
-    }
-    return listRe.isNegative;
+    if (_parsed)
+        return _result;
+    _parsed = true;
+
+    if (!_precompiled && (!parse_tokens() || !compile()))
+        return nullptr;
+    _result = std::make_shared<const Pattern>(_source, std::move(_compiled));
+    return _result;
 }
 
-bool RegParser::match_from_position(const char **start_pos, const TokenList &token_list, int idx, bool is_backtrack)
+bool RegParser::parse()
 {
-    const char *c = *start_pos;
-    const auto &regex = token_list.regex;
-    int rIdx = idx;
-    int pattern_length = regex.size();
-
-    sync_index(const_cast<TokenList *>(&token_list), rIdx);
-    if (idx >= pattern_length)
-        return true;
-
-    while (rIdx < pattern_length && *c != '\0')
-    {
-        int consumed = handle_quantified_match(&c, token_list, rIdx);
-        if (consumed <= 0)
-            return false;
-
-        rIdx += consumed;
-        sync_index(const_cast<TokenList *>(&token_list), rIdx);
-    }
-
-    *start_pos = c;
-
-    if (rIdx >= pattern_length)
-        return true;
+    if (_valid || !pattern())
+        return _valid;
 
-    if (*c == '\0')
-    {
-        return regex[rIdx].type == END || regex[rIdx].quantifier == MARK;
-    }
-
-    return false;
+    _matcher = std::make_unique<Matcher>(_result);
+    _matcher->set_limits(_limits);
+    _valid = true;
+    return true;
 }
 
-bool RegParser::can_match_next_here(const char *start_pos, const TokenList &token_list, int idx, bool is_backtracking)
+// a pattern made of nothing but literal bytes, also inside groups that
+// are neither quantified nor alternated, such as (abc)d
+static bool collect_literal(const TokenList &token_list, std::string &literal)
 {
-    const char *temp_pos = start_pos;
-    bool isMatched = false;
-    int restored_index = idx;
-
-    if (is_backtracking && idx >= token_list.regex.size())
+    for (const Re &re : token_list.regex)
     {
-
-        auto *parent_token_list = token_list.parent;
-        if (!parent_token_list || gp_stack.find(parent_token_list) == gp_stack.end())
-        {
-            return true; // Parent is invalid or not tracked, can't continue
-        }
-
-        int outer_next_index = gp_stack[parent_token_list] + 1;
-
-        const Re &previous = parent_token_list->regex[outer_next_index - 1];
-        if (previous.captured_gp_id >= 0)
-        {
-            const char *prev_gp_start = group_start[previous.captured_gp_id];
-            captures[previous.captured_gp_id] = {prev_gp_start,
-                                                 static_cast<size_t>(start_pos - prev_gp_start)};
-        }
-
-        while (parent_token_list && outer_next_index >= parent_token_list->regex.size())
-        {
-            parent_token_list = parent_token_list->parent;
-            if (!parent_token_list || gp_stack.find(parent_token_list) == gp_stack.end())
-            {
-                // break; // Parent is invalid or not tracked
-                return true;
-            }
-
-            outer_next_index = gp_stack[parent_token_list] + 1;
-            const Re &previous = parent_token_list->regex[outer_next_index - 1];
-            if (previous.captured_gp_id >= 0)
-            {
-                const char *prev_gp_start = group_start[previous.captured_gp_id];
-                captures[previous.captured_gp_id] = {prev_gp_start,
-                                                     static_cast<size_t>(start_pos - prev_gp_start)};
-            }
-        }
-        restored_index = outer_next_index - 1;
-        if (parent_token_list->regex[restored_index].quantifier == PLUS)
+        int byte = re.set.single();
+        if (re.quantifier != NONE)
+            return false;
+        if (re.type == STRING)
+            literal += re.ccl;
+        else if (re.type == ALT && re.alternatives.size() == 1)
         {
-            isMatched = match_from_position(&temp_pos, *parent_token_list, outer_next_index - 1, is_backtracking);
+            if (!collect_literal(re.alternatives[0], literal))
+                return false;
         }
+        else if (byte >= 0)
+            literal.push_back(static_cast<char>(byte));
         else
-        {
-            isMatched = match_from_position(&temp_pos, *parent_token_list, outer_next_index, is_backtracking);
-        }
-        sync_index(parent_token_list, restored_index);
-        return isMatched;
+            return false;
     }
-
-    isMatched = match_from_position(&temp_pos, token_list, idx, is_backtracking);
-    sync_index(const_cast<TokenList *>(&token_list), restored_index);
-    return isMatched;
+    return true;
 }
 
-int RegParser::handle_quantified_match(const char **c, const TokenList &token_list, int idx)
+static bool is_literal(const TokenList &token_list, std::string &literal)
 {
-    const auto &regex = token_list.regex;
-    const Re &current = regex[idx];
-
-    switch (current.quantifier)
-    {
-    case PLUS:
-        return handle_plus_quantifier(c, token_list, idx) ? 1 : 0;
-    case MARK:
-        return handle_question_quantifier(c, token_list, idx) ? 1 : 0;
-    case NONE:
-    default:
-        return handle_no_quantifier(c, token_list, idx) ? 1 : 0;
-    }
+    literal.clear();
+    if (!collect_literal(token_list, literal))
+        literal.clear();
+    return !literal.empty();
 }
 
-bool RegParser::handle_plus_quantifier(const char **c, const TokenList &token_list, int idx)
+bool RegParser::compile()
 {
-    const auto &regex = token_list.regex;
-    const Re &current = regex[idx];
-
-    if (current.type == ALT)
-    {
-        return match_alt_one_or_more(c, token_list, idx);
-    }
-    else
-    {
-        return match_one_or_more(c, token_list, idx);
-    }
+    optimize_pattern(token_list);
+    if (!_compiled.program.compile(token_list))
+        return false;
+    _compiled.required = required_literal(token_list);
+    is_literal(token_list, _compiled.literal);
+    _compiled.groups = next_capture_id - 1;
+    _compiled.empty = token_list.regex.empty();
+    return true;
 }
 
-bool RegParser::handle_question_quantifier(const char **c, const TokenList &token_list, int idx)
+EngineStats RegParser::stats() const
 {
-    const auto &regex = token_list.regex;
-    const Re &current = regex[idx];
-
-    if (current.type == ALT)
-    {
-        return match_alt_zero_or_one(c, token_list, idx);
-    }
-    else
-    {
-        return match_zero_or_one(c, token_list, idx);
-    }
+    if (_matcher)
+        return _matcher->stats();
+    EngineStats stats;
+    stats.patterns = _source;
+    return stats;
 }
 
-bool RegParser::handle_no_quantifier(const char **c, const TokenList &token_list, int idx)
+void RegParser::set_limits(const MatchLimits &limits)
 {
-    const auto &regex = token_list.regex;
-    const Re &current = regex[idx];
-
-    if (current.type == ALT)
-    {
-        return handle_alternation(c, token_list, idx);
-    }
-    else
-    {
-        return handle_single_match(c, token_list, idx);
-    }
+    _limits = limits;
+    if (_matcher)
+        _matcher->set_limits(limits);
 }
 
-bool RegParser::handle_alternation(const char **c, const TokenList &token_list, int idx)
+RegParser::RegParser(const std::string &pattern) : _source(pattern), _pattern(_source.c_str()), _begin(_source.c_str()), _end(_begin + _source.size())
 {
-    const auto &regex = token_list.regex;
-    const Re &current = regex[idx];
-    group_start[current.captured_gp_id] = *c;
-
-    for (const auto &alt : current.alternatives)
-    {
-        const char *temp_c = *c;
-        if (match_from_position(&temp_c, alt, 0))
-        {
-
-            if (current.captured_gp_id >= 0)
-            {
-                captures[current.captured_gp_id] = {*c, static_cast<size_t>(temp_c - *c)};
-#ifdef DEBUG
-                std::cout << "Captured group " << current.captured_gp_id << ": ";
-                for (size_t i = 0; i < captures[current.captured_gp_id].length; ++i)
-                    std::cout << captures[current.captured_gp_id].start[i];
-                std::cout << std::endl;
-#endif
-            }
-            *c = temp_c;
-            return true;
-        }
-    }
-    return false;
 }
 
-bool RegParser::handle_single_match(const char **c, const TokenList &token_list, int idx)
+RegParser::RegParser(const std::string &pattern, CompiledPattern compiled) : RegParser(pattern)
 {
-    const auto &regex = token_list.regex;
-    const Re &current = regex[idx];
-
-    if (current.type == BACKREF)
-    {
-        int gp_id = current.captured_gp_id;
-
-        if (captures.find(gp_id) == captures.end())
-            return false;
-
-        const CaptureGroup &cap = captures[gp_id];
-
-        // Check if we have enough characters remaining in the input
-        if (strlen(*c) < cap.length)
-            return false;
-
-        for (size_t i = 0; i < cap.length; ++i)
-        {
-            if ((*c)[i] != cap.start[i])
-                return false;
-        }
-        *c += cap.length;
-        return true;
-    }
-    if (match_current(*c, regex, idx))
-    {
-        if (!(regex[idx].type == START || regex[idx].type == END))
-        {
-            ++(*c);
-        }
-        return true;
-    }
-    return false;
+    _compiled = std::move(compiled);
+    _precompiled = true;
 }
 
-bool RegParser::match_one_or_more(const char **c, const TokenList &token_list, int idx)
-{
-    const auto &regex = token_list.regex;
-    const Re &current = regex[idx];
-
-    const char *t = *c;
+RegParser::~RegParser() = default;
 
-    if (!match_current(t, regex, idx))
-        return false;
-    ++t;
-
-    const char *temp_pos = t;
-    while (*t != '\0' && match_current(t, regex, idx))
-    {
-        ++t;
-    }
-
-    if (temp_pos == t)
-    {
-        *c = t;
-        return true;
-    }
-
-    while (t > *c)
-    {
-        const char *test_pos = t;
-        if (can_match_next_here(test_pos, token_list, idx + 1, true))
-        {
-            *c = test_pos;
-            return true;
-        }
-        --t;
-    }
-    return false;
-}
-
-bool RegParser::match_alt_one_or_more(const char **c, const TokenList &token_list, int idx)
+bool RegParser::match(std::string_view line)
 {
-    const auto &regex = token_list.regex;
-    const Re &altGp = regex[idx];
-    std::vector<const char *> match_ends;
-    const char *pos = *c;
-
-    // match as far as it could go (greedy)
-    while (*pos != '\0')
-    {
-        // const char *match_start = pos;
-        bool found_match = false;
-
-        for (const auto &alt : altGp.alternatives)
-        {
-            const char *temp_pos = pos;
-            if (match_from_position(&temp_pos, alt, 0))
-            {
-                if (temp_pos == pos)
-                {
-                    continue;
-                }
-                // return false;
-                match_ends.push_back(temp_pos); // store end pos
-                pos = temp_pos;
-                found_match = true;
-                break;
-            }
-        }
-
-        if (!found_match)
-            break;
-    }
-
-    if (match_ends.empty())
-        return false;
-
-    // backtracking
-
-    for (int num_matches = match_ends.size() - 1; num_matches >= 0; num_matches--)
-    {
-        const char *t = match_ends[num_matches];
-        if (can_match_next_here(t, token_list, idx + 1, true))
-        {
-
-            if (altGp.captured_gp_id >= 0)
-            {
-                const char *last_match_start = (num_matches > 0) ? match_ends[num_matches - 1] : *c;
-                captures[altGp.captured_gp_id] = {last_match_start,
-                                                  static_cast<size_t>(match_ends[num_matches] - last_match_start)};
-#ifdef DEBUG
-                std::cout << "Captured group " << altGp.captured_gp_id << ": ";
-                for (size_t i = 0; i < captures[altGp.captured_gp_id].length; ++i)
-                    std::cout << captures[altGp.captured_gp_id].start[i];
-                std::cout << std::endl;
-#endif
-            }
-            *c = t;
-            return true;
-        }
-    }
-    return false;
+    return parse() && _matcher->match(line);
 }
 
-bool RegParser::match_zero_or_one(const char **c, const TokenList &token_list, int idx)
+bool RegParser::find(std::string_view line, size_t start, MatchResult &result)
 {
-    const auto &regex = token_list.regex;
-    const Re &current = regex[idx];
-
-    if (match_current(*c, regex, idx))
-    {
-        const char *temp_pos = *c + 1;
-        if (can_match_next_here(temp_pos, token_list, idx + 1, true))
-        {
-            *c = temp_pos;
-            return true;
-        }
-    }
-
-    // Try matching without the character (zero occurrences)
-    return true;
-    // return can_match_next_here(*c, token_list, idx + 1);
+    if (parse())
+        return _matcher->find(line, start, result);
+    result.groups.assign(1, MatchSpan{});
+    return false;
 }
 
-bool RegParser::match_alt_zero_or_one(const char **c, const TokenList &token_list, int idx)
+const char *RegParser::find_line(const char *begin, const char *end)
 {
-    const auto &regex = token_list.regex;
-    const Re &altGp = regex[idx];
-
-    for (const auto &alt : altGp.alternatives)
-    {
-        const char *t = *c;
-        if (match_from_position(&t, alt, 0))
-        {
-            const char *temp_t = t;
-
-            if (can_match_next_here(t, token_list, idx + 1, true))
-            {
-                if (altGp.captured_gp_id >= 0)
-                {
-                    captures[altGp.captured_gp_id] = {*c, static_cast<size_t>(temp_t - *c)};
-#ifdef DEBUG
-                    std::cout << "Captured group " << altGp.captured_gp_id << ": ";
-                    for (size_t i = 0; i < captures[altGp.captured_gp_id].length; ++i)
-                        std::cout << captures[altGp.captured_gp_id].start[i];
-                    std::cout << std::endl;
-#endif
-                }
-                *c = t;
-
-                return true;
-            }
-        }
-    }
-    return true;
+    return parse() ? _matcher->find_line(begin, end) : nullptr;
 }
 
 bool RegParser::consume()
@@ -614,16 +309,26 @@ Re RegParser::parseElement()
             int gp_num = *_pattern - '0';
             consume();
 
+            // only groups opened earlier in the pattern can be referred to
+            if (gp_num == 0 || gp_num >= next_capture_id)
+                return makeRe(ETK);
             Re current = makeRe(BACKREF);
             current.captured_gp_id = gp_num;
             applyQuantifiers(current);
             return current;
         }
-        else
+        else if (!isEof())
         {
+            // any other escaped byte stands for itself: \. \* \{ \\ ...
+            Re current = makeRe(SINGLE_CHAR, std::string(_pattern, 1));
+            current.set = CharSet();
+            current.set.set(static_cast<unsigned char>(*_pattern));
             consume();
-            return makeRe(ETK);
+            applyQuantifiers(current);
+            return current;
         }
+        else
+            return makeRe(ETK);
     }
     else if (match('['))
         return parseCharacterClass();
@@ -650,8 +355,10 @@ Re RegParser::parseCharacterClass()
     current.isNegative = match('^');
     while (!isEof() && !check(']'))
     {
-        buffer.push_back(*_pattern);
-        consume();
+        const char *item = _pattern;
+        if (!parseClassItem(current.set))
+            return makeRe(ETK);
+        buffer.append(item, _pattern);
     }
 
     if (!match(']'))
@@ -660,11 +367,65 @@ Re RegParser::parseCharacterClass()
         return makeRe(ETK);
     }
 
+    if (current.isNegative)
+    {
+        // lines never contain '\n'; keeping it out lets the DFA scan across lines
+        current.set.invert();
+        current.set.reset('\n');
+    }
     current.ccl = buffer;
     applyQuantifiers(current);
     return current;
 }
 
+// one member of a bracket expression: a byte, an escape (\d, \w or an escaped
+// literal such as \] or \\) or a range "a-z"
+bool RegParser::parseClassItem(CharSet &set)
+{
+    unsigned char lo = static_cast<unsigned char>(*_pattern);
+    consume();
+    if (lo == '\\')
+    {
+        if (isEof())
+            return false;
+        char escaped = *_pattern;
+        consume();
+        if (escaped == 'd')
+        {
+            set.merge(CharSet::digits());
+            return true;
+        }
+        if (escaped == 'w')
+        {
+            set.merge(CharSet::word());
+            return true;
+        }
+        lo = static_cast<unsigned char>(escaped);
+    }
+
+    // '-' first, last or after a range is a literal
+    if (check('-') && _pattern + 1 < _end && _pattern[1] != ']')
+    {
+        consume();
+        unsigned char hi = static_cast<unsigned char>(*_pattern);
+        consume();
+        if (hi == '\\')
+        {
+            if (isEof())
+                return false;
+            hi = static_cast<unsigned char>(*_pattern);
+            consume();
+        }
+        if (hi < lo)
+            return false;
+        set.set_range(lo, hi);
+        return true;
+    }
+
+    set.set(lo);
+    return true;
+}
+
 Re RegParser::parseGroup()
 {
     if (parser_gp_stack.empty())
@@ -716,13 +477,82 @@ Re RegParser::parseGroup()
 
 void RegParser::applyQuantifiers(Re &element)
 {
-    if (!isEof() && match('+'))
+    if (match('+'))
         element.quantifier = PLUS;
-    else if (!isEof() && match('?'))
+    else if (match('*'))
+        element.quantifier = STAR;
+    else if (match('?'))
         element.quantifier = MARK;
+    else if (!check('{') || !parseRepeat(element))
+        return;
+
+    // a trailing '?' prefers as few repetitions as possible
+    element.lazy = match('?');
+}
+
+// {m}, {m,}, {,n} or {m,n} (a missing bound is 0 or unbounded); anything
+// else leaves the '{' to be read as a literal
+bool RegParser::parseRepeat(Re &element)
+{
+    const char *p = _pattern + 1;
+    auto read_count = [&](int &count)
+    {
+        const char *digits = p;
+        count = 0;
+        while (p < _end && std::isdigit(static_cast<unsigned char>(*p)))
+        {
+            count = std::min(count * 10 + (*p - '0'), max_repeat + 1);
+            ++p;
+        }
+        return p > digits;
+    };
+
+    int min = 0;
+    int max = 0;
+    bool has_min = read_count(min);
+    bool has_comma = p < _end && *p == ',';
+    if (has_comma)
+    {
+        ++p;
+        if (!read_count(max))
+            max = -1;
+    }
+    else
+        max = min;
+    if (p >= _end || *p != '}' || (!has_min && !has_comma))
+        return false;
+    _pattern = p + 1;
+
+    element.quantifier = REPEAT;
+    element.repeat_min = min;
+    element.repeat_max = max;
+    if (min > max_repeat || max > max_repeat || (max >= 0 && min > max))
+        element.type = ETK;
+    return true;
 }
 
 Re RegParser::makeRe(RegType type, const std::string &ccl, bool isNegative)
 {
-    return Re(type, ccl, isNegative);
+    Re re(type, ccl, isNegative);
+    switch (type)
+    {
+    case DIGIT:
+        re.set = CharSet::digits();
+        break;
+    case ALPHANUM:
+        re.set = CharSet::word();
+        break;
+    case SINGLE_CHAR:
+        if (ccl[0] == '.')
+        {
+            re.set.set_all();
+            re.set.reset('\n');
+        }
+        else
+            re.set.set(static_cast<unsigned char>(ccl[0]));
+        break;
+    default:
+        break;
+    }
+    return re;
 }
@@ -1,127 +1,146 @@
 #include <iostream>
-#include <fstream>
 #include <string>
-#include <cctype>
-#include "include/RegParser.h"
-#include <filesystem>
+#include "include/PatternSet.h"
+#include "include/FileFollower.h"
+#include "include/FileScanner.h"
+#include "include/Options.h"
+#include "include/OutputSink.h"
+#include "include/ParallelSearch.h"
+#include "include/PatternCache.h"
+#include "include/TrigramIndex.h"
+#include <fcntl.h>
+#include <memory>
+#include <sys/stat.h>
+#include <unistd.h>
 
-bool match_pattern(const std::string &input_line, const std::string &pattern)
+int main(int argc, char *argv[])
 {
-    try
-    {
-        RegParser rp(pattern);
-        return rp.match(input_line);
-    }
-    catch (const std::exception &e)
-    {
-        throw std::runtime_error("Unhandled pattern " + pattern);
-    }
-}
+    // Matches go through the batched OutputSink; only diagnostics are unbuffered
+    std::cerr << std::unitbuf;
 
-bool any_match(std::istream &in, const std::string &pattern, const std::string &filename = "")
-{
-    std::string line;
-    bool isMatched = false;
-    while (std::getline(in, line))
-    {
-        if (match_pattern(line, pattern))
-        {
-            isMatched = true;
-            if (!filename.empty())
-                std::cout << filename << ":";
-            std::cout << line << std::endl;
-        }
-    }
-    return isMatched;
-}
+    // You can use print statements as follows for debugging, they'll be visible when running tests.
+    // std::cerr << "Logs from your program will appear here" << std::endl;
 
-bool search_directory(const std::string &path, const std::string &pattern)
-{
-    bool is_found = false;
-    for (auto const &entry : std::filesystem::recursive_directory_iterator(path))
+    Options opts;
+    if (!parse_options(argc, argv, opts))
+        return 1;
+
+    if (opts.index)
     {
-        if (entry.is_regular_file())
+        bool ok = true;
+        for (const auto &root : opts.paths)
         {
-            std::ifstream file(entry.path());
-            if (!file.is_open())
+            TrigramIndex::Summary summary;
+            if (!TrigramIndex::update(root, opts, summary))
             {
-                std::cerr << "Failed to open file: " << entry.path() << std::endl;
+                std::cerr << "Failed to write index: " << root << "/" << TrigramIndex::file_name << std::endl;
+                ok = false;
                 continue;
             }
-            is_found |= any_match(file, pattern, entry.path().string());
+            std::cout << root << ": " << summary.files << " files indexed, " << summary.updated << " read, "
+                      << summary.removed << " removed" << std::endl;
         }
+        return ok ? 0 : 1;
     }
-    return is_found;
-}
-
-int main(int argc, char *argv[])
-{
-    // Flush after every std::cout / std::cerr
-    std::cout << std::unitbuf;
-    std::cerr << std::unitbuf;
 
-    // You can use print statements as follows for debugging, they'll be visible when running tests.
-    // std::cerr << "Logs from your program will appear here" << std::endl;
-
-    if (argc < 3)
+    // compiled once and reused for every line of every input
+    PatternSet patterns(opts.patterns);
+    std::unique_ptr<PatternCache> cache;
+    if (!opts.cache_dir.empty())
+    {
+        cache = std::make_unique<PatternCache>(opts.cache_dir);
+        patterns.set_cache(cache.get());
+    }
+    if (!patterns.parse())
     {
-        std::cerr << "Expected two arguments" << std::endl;
+        std::cerr << "Unhandled pattern " << patterns.invalid_pattern() << std::endl;
         return 1;
     }
 
-    std::string flag = argv[1];
+    OutputSink out(STDOUT_FILENO);
+    out.set_line_buffered(opts.line_buffered);
 
-    if (flag == "-E")
+    // only built for -r, or once a file is large enough to be split across threads
+    std::unique_ptr<ParallelSearch> search;
+    MatchStats stats;
+
+    // --stats goes to stderr after everything else has been written
+    auto finish = [&](bool found)
     {
-        std::string pattern = argv[2];
-        std::string filename;
-        try
-        {
-            if (argc >= 4)
-            {
-                bool is_found = false;
-                for (int i = 3; i < argc; ++i)
-                {
-                    filename = argv[i];
-                    if (!filename.empty())
-                    {
-                        std::ifstream file(filename);
-                        if (!file.is_open())
-                        {
-                            std::cerr << "Failed to open file: " << filename << std::endl;
-                            return 1;
-                        }
-                        is_found |= any_match(file, pattern, argc > 4 ? filename : "");
-                    }
-                }
-                return !is_found;
-            }
-            else
-            {
-                return any_match(std::cin, pattern) ? 0 : 1;
-            }
-        }
-        catch (const std::runtime_error &e)
+        if (opts.stats)
         {
-            std::cerr << e.what() << std::endl;
-            return 1;
+            out.flush();
+            patterns.collect_stats(stats);
+            if (search)
+                search->collect_stats(stats);
+            stats.print(std::cerr);
         }
+        return found ? 0 : 1;
+    };
+
+    if (opts.recursive)
+    {
+        search = std::make_unique<ParallelSearch>(opts, patterns, out);
+        bool found = false;
+        for (const auto &root : opts.paths)
+            found |= search->search(root);
+        return finish(found);
     }
-    else if (flag == "-r")
+
+    if (opts.follow && !opts.paths.empty())
+    {
+        FileFollower follower(opts, patterns, out);
+        return finish(follower.run());
+    }
+
+    FileScanner scanner(patterns, &out);
+    scanner.set_line_numbers(opts.line_numbers);
+    scanner.set_mode(opts.mode);
+    if (opts.context)
+        scanner.set_context(opts.after_context, opts.before_context);
+    scanner.set_max_count(opts.max_count);
+    scanner.set_limits(opts.max_steps, opts.timeout);
+    if (opts.stats)
+        scanner.set_stats(&stats);
+    if (opts.paths.empty())
     {
-        if (argc < 4)
+        // --follow on a pipe: every line is printed as soon as it is read
+        if (opts.follow)
+            out.set_line_buffered(true);
+        return finish(scanner.scan_fd(STDIN_FILENO));
+    }
+
+    bool is_found = false;
+    for (const auto &filename : opts.paths)
+    {
+        if (filename.empty())
+            continue;
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
         {
-            std::cerr << "Expected pattern and directory" << std::endl;
+            std::cerr << "Failed to open file: " << filename << std::endl;
             return 1;
         }
-        std::string pattern = argv[3];
-        std::string dir = argv[4];
-        bool found = search_directory(dir, pattern);
-        return found ? 0 : 1;
-    }
-    else
-    {
-        std::cerr << "Expected first argument to be '-E'" << std::endl;
-        return 1;
+        std::string label = opts.paths.size() > 1 ? filename : "";
+        struct stat st;
+        if (opts.jobs != 1 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+            static_cast<size_t>(st.st_size) >= 2 * ParallelSearch::chunk_size)
+        {
+            if (!search)
+                search = std::make_unique<ParallelSearch>(opts, patterns, out);
+            if (search->splits(static_cast<size_t>(st.st_size)))
+            {
+                is_found |= search->search_large_file(fd, static_cast<size_t>(st.st_size), label, filename);
+                close(fd);
+                continue;
+            }
+        }
+        is_found |= scanner.scan_fd(fd, label, filename);
+        close(fd);
+
+        // -q: the exit status is decided, the remaining files do not matter
+        if (is_found && opts.mode == PRINT_NOTHING)
+            break;
     }
+    return finish(is_found);
 }
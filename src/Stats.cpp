@@ -0,0 +1,88 @@
+#include "include/Stats.h"
+
+#include <algorithm>
+#include <cstdio>
+
+void MatchStats::merge(const MatchStats &other)
+{
+    files.insert(files.end(), other.files.begin(), other.files.end());
+    read_seconds += other.read_seconds;
+    if (engines.empty())
+    {
+        engines = other.engines;
+        return;
+    }
+    for (size_t i = 0; i < std::min(engines.size(), other.engines.size()); ++i)
+    {
+        EngineStats &e = engines[i];
+        const EngineStats &o = other.engines[i];
+        e.candidates += o.candidates;
+        e.confirmed += o.confirmed;
+        e.steps += o.steps;
+        e.states = std::max(e.states, o.states); // every thread builds the same automaton
+        e.flushes += o.flushes;
+        e.abandoned += o.abandoned;
+    }
+}
+
+static double throughput(uint64_t bytes, double seconds)
+{
+    return seconds > 0 ? static_cast<double>(bytes) / (1 << 20) / seconds : 0;
+}
+
+static void print_row(std::ostream &out, const char *name, uint64_t bytes, uint64_t lines, uint64_t matches,
+                      double seconds)
+{
+    char row[160];
+    snprintf(row, sizeof(row), "%14llu %12llu %10llu %10.2f %10.1f  ", static_cast<unsigned long long>(bytes),
+             static_cast<unsigned long long>(lines), static_cast<unsigned long long>(matches), seconds * 1e3,
+             throughput(bytes, seconds));
+    out << row << name << '\n';
+}
+
+void MatchStats::print(std::ostream &out) const
+{
+    char row[160];
+    snprintf(row, sizeof(row), "%14s %12s %10s %10s %10s  %s\n", "bytes", "lines", "matches", "ms", "MB/s", "file");
+    out << row;
+
+    FileStats total;
+    for (const FileStats &file : files)
+    {
+        print_row(out, file.name.c_str(), file.bytes, file.lines, file.matches, file.seconds);
+        total.bytes += file.bytes;
+        total.lines += file.lines;
+        total.matches += file.matches;
+        total.seconds += file.seconds;
+    }
+    // with several threads the per-file times overlap, so this is CPU time, not wall time
+    if (files.size() > 1)
+        print_row(out, "(total)", total.bytes, total.lines, total.matches, total.seconds);
+    if (read_seconds > 0)
+    {
+        snprintf(row, sizeof(row), "read: %.2f ms, matching: %.2f ms\n", read_seconds * 1e3,
+                 std::max(0.0, total.seconds - read_seconds) * 1e3);
+        out << row;
+    }
+
+    for (const EngineStats &e : engines)
+    {
+        out << "engine " << e.engine << ": " << e.patterns;
+        if (e.states > 0)
+            out << ", " << e.states << " states";
+        if (e.flushes > 0)
+            out << ", " << e.flushes << " cache flushes";
+        if (e.steps > 0)
+            out << ", " << e.steps << " backtrack steps";
+        if (e.abandoned > 0)
+            out << ", " << e.abandoned << " lines abandoned";
+        if (!e.prefilter.empty())
+        {
+            double rate = e.candidates > 0 ? 100.0 * static_cast<double>(e.confirmed) / static_cast<double>(e.candidates) : 0;
+            snprintf(row, sizeof(row), "%.1f%%", rate);
+            out << ", prefilter \"" << e.prefilter << "\": " << e.candidates << " candidate lines, " << e.confirmed
+                << " matched (" << row << ")";
+        }
+        out << '\n';
+    }
+}
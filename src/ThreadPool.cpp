@@ -0,0 +1,106 @@
+#include "include/ThreadPool.h"
+
+// lets submit() from inside a task push onto the calling worker's own deque
+static thread_local const ThreadPool *current_pool = nullptr;
+static thread_local size_t current_worker = 0;
+
+ThreadPool::ThreadPool(size_t threads)
+{
+    if (threads == 0)
+        threads = 1;
+    for (size_t i = 0; i < threads; ++i)
+        _queues.push_back(std::make_unique<Queue>());
+    for (size_t i = 0; i < threads; ++i)
+        _workers.emplace_back(&ThreadPool::run, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(_idle_lock);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    for (auto &worker : _workers)
+        worker.join();
+}
+
+void ThreadPool::submit(Task task)
+{
+    size_t target = current_worker;
+    {
+        // counted before it is published: a worker may pop and finish it
+        // before this thread gets the lock again
+        std::lock_guard<std::mutex> guard(_idle_lock);
+        if (current_pool != this)
+            target = _next_queue++ % _queues.size();
+        ++_pending;
+        ++_queued;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(_queues[target]->lock);
+        _queues[target]->tasks.push_back(std::move(task));
+    }
+    _wake.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> guard(_idle_lock);
+    _done.wait(guard, [this] { return _pending == 0; });
+}
+
+bool ThreadPool::pop_task(size_t worker, Task &task)
+{
+    // own deque first, newest task
+    {
+        Queue &own = *_queues[worker];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            --_queued;
+            return true;
+        }
+    }
+    // then steal the oldest task from the others
+    for (size_t i = 1; i < _queues.size(); ++i)
+    {
+        Queue &victim = *_queues[(worker + i) % _queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --_queued;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run(size_t worker)
+{
+    current_pool = this;
+    current_worker = worker;
+
+    while (true)
+    {
+        Task task;
+        if (pop_task(worker, task))
+        {
+            task(worker);
+            std::lock_guard<std::mutex> guard(_idle_lock);
+            if (--_pending == 0)
+                _done.notify_all();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(_idle_lock);
+        _wake.wait(guard, [this] { return _stopping || _queued > 0; });
+        if (_stopping && _queued == 0)
+            return;
+    }
+}
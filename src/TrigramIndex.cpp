@@ -0,0 +1,601 @@
+#include "include/TrigramIndex.h"
+#include "include/BinaryFile.h"
+#include "include/DirWalker.h"
+#include "include/RegParser.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <iterator>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr uint32_t magic = 0x49545052; // "RPTI"
+static constexpr uint32_t byte_order = 0x01020304;
+static constexpr size_t trigram_entry_size = 16; // trigram, posting count, posting offset
+
+// an exact run may stand for this many strings before it is cut short, and a
+// class of up to max_class_bytes bytes counts as that many one-byte strings
+static constexpr size_t max_strings = 16;
+static constexpr int max_class_bytes = 4;
+
+TrigramQuery TrigramQuery::all_of(std::vector<TrigramQuery> queries)
+{
+    TrigramQuery query;
+    query.op = QUERY_AND;
+    for (auto &child : queries)
+    {
+        if (child.op == QUERY_NONE)
+            return child;
+        if (child.op == QUERY_AND)
+            std::move(child.children.begin(), child.children.end(), std::back_inserter(query.children));
+        else if (child.op != QUERY_ALL)
+            query.children.push_back(std::move(child));
+    }
+    if (query.children.size() <= 1)
+        return query.children.empty() ? TrigramQuery() : std::move(query.children[0]);
+    return query;
+}
+
+TrigramQuery TrigramQuery::any_of(std::vector<TrigramQuery> queries)
+{
+    TrigramQuery query;
+    query.op = QUERY_OR;
+    for (auto &child : queries)
+    {
+        if (child.op == QUERY_ALL)
+            return child;
+        if (child.op == QUERY_OR)
+            std::move(child.children.begin(), child.children.end(), std::back_inserter(query.children));
+        else if (child.op != QUERY_NONE)
+            query.children.push_back(std::move(child));
+    }
+    if (query.children.empty())
+        query.op = QUERY_NONE;
+    else if (query.children.size() == 1)
+        return std::move(query.children[0]);
+    return query;
+}
+
+// a file containing one of strings holds all the trigrams of that string;
+// one too short to have any lets every file through
+static TrigramQuery strings_query(const std::vector<std::string> &strings)
+{
+    std::vector<TrigramQuery> any;
+    for (const auto &s : strings)
+    {
+        std::vector<TrigramQuery> all;
+        for (size_t i = 0; i + 3 <= s.size(); ++i)
+        {
+            TrigramQuery trigram;
+            trigram.op = TrigramQuery::QUERY_TRIGRAM;
+            trigram.trigram = static_cast<uint32_t>(static_cast<unsigned char>(s[i])) << 16 |
+                              static_cast<uint32_t>(static_cast<unsigned char>(s[i + 1])) << 8 |
+                              static_cast<unsigned char>(s[i + 2]);
+            all.push_back(trigram);
+        }
+        any.push_back(TrigramQuery::all_of(std::move(all)));
+    }
+    return TrigramQuery::any_of(std::move(any));
+}
+
+// every concatenation of a string of prefixes with one of suffixes; false
+// when there would be more than max_strings
+static bool concatenate(std::vector<std::string> &prefixes, const std::vector<std::string> &suffixes)
+{
+    if (prefixes.size() * suffixes.size() > max_strings)
+        return false;
+    std::vector<std::string> product;
+    for (const auto &prefix : prefixes)
+        for (const auto &suffix : suffixes)
+            product.push_back(prefix + suffix);
+    prefixes = std::move(product);
+    return true;
+}
+
+static bool sequence_strings(const std::vector<Re> &list, std::vector<std::string> &strings);
+
+// the strings one round of re can match, ignoring its quantifier; false when
+// they are not few and fixed
+static bool element_strings(const Re &re, std::vector<std::string> &strings)
+{
+    strings.clear();
+    switch (re.type)
+    {
+    case SINGLE_CHAR:
+    case DIGIT:
+    case ALPHANUM:
+    case LIST:
+        if (re.set.count() > max_class_bytes)
+            return false;
+        for (int c = 0; c < 256; ++c)
+        {
+            if (re.set.test(static_cast<unsigned char>(c)))
+                strings.push_back(std::string(1, static_cast<char>(c)));
+        }
+        return !strings.empty();
+    case STRING:
+        strings.push_back(re.ccl);
+        return true;
+    case START:
+    case END:
+        // zero-width, so neighbouring strings still meet
+        strings.push_back("");
+        return true;
+    case ALT:
+        for (const TokenList &alternative : re.alternatives)
+        {
+            std::vector<std::string> more;
+            if (!sequence_strings(alternative.regex, more) || strings.size() + more.size() > max_strings)
+                return false;
+            strings.insert(strings.end(), more.begin(), more.end());
+        }
+        return !strings.empty();
+    default:
+        return false;
+    }
+}
+
+// the strings a whole sequence of unquantified, exact elements can match
+static bool sequence_strings(const std::vector<Re> &list, std::vector<std::string> &strings)
+{
+    strings.assign(1, "");
+    std::vector<std::string> element;
+    for (const Re &re : list)
+    {
+        if (re.quantifier != NONE || !element_strings(re, element) || !concatenate(strings, element))
+            return false;
+    }
+    return true;
+}
+
+static TrigramQuery sequence_query(const std::vector<Re> &list)
+{
+    std::vector<TrigramQuery> parts;
+    std::vector<std::string> run(1, ""); // the exact strings the current run of elements can be
+    std::vector<std::string> element;
+    for (const Re &re : list)
+    {
+        // x+ and x{2,} contain at least one x, after which the run must end
+        bool required = re.quantifier == NONE || re.quantifier == PLUS || (re.quantifier == REPEAT && re.repeat_min > 0);
+        bool exact = required && element_strings(re, element);
+        if (exact && !concatenate(run, element))
+        {
+            parts.push_back(strings_query(run));
+            run = element;
+        }
+        else if (!exact)
+        {
+            parts.push_back(strings_query(run));
+            run.assign(1, "");
+            if (required && re.type == ALT)
+            {
+                std::vector<TrigramQuery> alternatives;
+                for (const TokenList &alternative : re.alternatives)
+                    alternatives.push_back(sequence_query(alternative.regex));
+                parts.push_back(TrigramQuery::any_of(std::move(alternatives)));
+            }
+            continue;
+        }
+        if (re.quantifier != NONE)
+        {
+            parts.push_back(strings_query(run));
+            run.assign(1, "");
+        }
+    }
+    parts.push_back(strings_query(run));
+    return TrigramQuery::all_of(std::move(parts));
+}
+
+TrigramQuery TrigramQuery::from_tokens(const TokenList &token_list)
+{
+    return sequence_query(token_list.regex);
+}
+
+TrigramQuery TrigramQuery::from_patterns(const std::vector<std::string> &patterns)
+{
+    std::vector<TrigramQuery> any;
+    for (const auto &source : patterns)
+    {
+        RegParser parser(source);
+        auto pattern = parser.pattern();
+        if (!pattern)
+            return TrigramQuery();
+        // the empty pattern never matches
+        if (pattern->compiled().empty)
+            continue;
+        any.push_back(from_tokens(parser.token_list));
+    }
+    return any_of(std::move(any));
+}
+
+TrigramIndex::~TrigramIndex()
+{
+    if (_data)
+        munmap(const_cast<char *>(_data), _size);
+}
+
+static std::string directory_base(const std::string &root)
+{
+    return root.empty() || root.back() == '/' ? root : root + "/";
+}
+
+static int64_t mtime_of(const struct stat &st)
+{
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+bool TrigramIndex::load(const std::string &root)
+{
+    _base = directory_base(root);
+    int fd = open((_base + file_name).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    _data = static_cast<const char *>(data);
+    _size = static_cast<size_t>(st.st_size);
+
+    BinaryReader in{_data, _data + _size};
+    bool ok = in.u32() == magic && in.u32() == format_version && in.u32() == byte_order;
+    uint32_t files = in.u32();
+    _trigram_count = in.u32();
+    _postings_size = in.u64();
+    // every entry takes at least 20 bytes
+    ok = ok && in.ok && files <= static_cast<size_t>(in.end - in.pos) / 20;
+    for (uint32_t i = 0; ok && i < files; ++i)
+    {
+        Entry entry;
+        entry.size = in.u64();
+        entry.mtime = in.i64();
+        uint32_t length = in.u32();
+        const char *path = in.skip(length);
+        ok = in.ok;
+        if (ok)
+        {
+            entry.path = std::string_view(path, length);
+            _ids.emplace(entry.path, i);
+            _files.push_back(entry);
+        }
+    }
+    _trigrams = ok && _trigram_count <= static_cast<size_t>(in.end - in.pos) / trigram_entry_size
+                    ? in.skip(_trigram_count * trigram_entry_size)
+                    : nullptr;
+    _postings = in.skip(_postings_size);
+    if (!ok || !in.ok || !_trigrams)
+    {
+        _files.clear();
+        _ids.clear();
+        _trigram_count = 0;
+        _postings_size = 0;
+        return false;
+    }
+    return true;
+}
+
+std::vector<uint32_t> TrigramIndex::posting_list(uint32_t trigram) const
+{
+    // binary search of the table, whose entries are not aligned
+    auto trigram_at = [this](size_t i)
+    {
+        uint32_t value;
+        memcpy(&value, _trigrams + i * trigram_entry_size, sizeof(value));
+        return value;
+    };
+    size_t low = 0;
+    size_t high = _trigram_count;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (trigram_at(mid) < trigram)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    std::vector<uint32_t> ids;
+    if (low == _trigram_count || trigram_at(low) != trigram)
+        return ids;
+    uint32_t count;
+    uint64_t offset;
+    memcpy(&count, _trigrams + low * trigram_entry_size + 4, sizeof(count));
+    memcpy(&offset, _trigrams + low * trigram_entry_size + 8, sizeof(offset));
+    if (offset > _postings_size)
+        return ids;
+
+    BinaryReader in{_postings + offset, _postings + _postings_size};
+    uint32_t id = 0;
+    for (uint32_t i = 0; i < count && in.ok; ++i)
+    {
+        id += in.varint();
+        if (in.ok && id < _files.size())
+            ids.push_back(id);
+    }
+    return ids;
+}
+
+std::vector<uint32_t> TrigramIndex::evaluate(const TrigramQuery &query) const
+{
+    std::vector<uint32_t> ids;
+    switch (query.op)
+    {
+    case TrigramQuery::QUERY_ALL:
+        ids.resize(_files.size());
+        for (uint32_t i = 0; i < ids.size(); ++i)
+            ids[i] = i;
+        break;
+    case TrigramQuery::QUERY_NONE:
+        break;
+    case TrigramQuery::QUERY_TRIGRAM:
+        ids = posting_list(query.trigram);
+        break;
+    case TrigramQuery::QUERY_AND:
+        for (size_t i = 0; i < query.children.size(); ++i)
+        {
+            std::vector<uint32_t> child = evaluate(query.children[i]);
+            if (i > 0)
+            {
+                std::vector<uint32_t> both;
+                std::set_intersection(ids.begin(), ids.end(), child.begin(), child.end(), std::back_inserter(both));
+                child = std::move(both);
+            }
+            ids = std::move(child);
+            if (ids.empty())
+                break;
+        }
+        break;
+    case TrigramQuery::QUERY_OR:
+        for (const auto &child_query : query.children)
+        {
+            std::vector<uint32_t> child = evaluate(child_query);
+            std::vector<uint32_t> either;
+            std::set_union(ids.begin(), ids.end(), child.begin(), child.end(), std::back_inserter(either));
+            ids = std::move(either);
+        }
+        break;
+    }
+    return ids;
+}
+
+void TrigramIndex::select(const TrigramQuery &query)
+{
+    _selected.clear();
+    if (query.op == TrigramQuery::QUERY_ALL)
+        return;
+    _selected.assign(_files.size(), false);
+    for (uint32_t id : evaluate(query))
+        _selected[id] = true;
+}
+
+bool TrigramIndex::excludes(const std::string &path) const
+{
+    if (!_data || path.compare(0, _base.size(), _base) != 0)
+        return false;
+    // --hidden would otherwise search the index itself
+    std::string_view relative = std::string_view(path).substr(_base.size());
+    if (relative == file_name)
+        return true;
+    auto it = _ids.find(relative);
+    if (_selected.empty() || it == _ids.end() || _selected[it->second])
+        return false;
+
+    // a file changed since it was indexed may match now
+    struct stat st;
+    const Entry &entry = _files[it->second];
+    return stat(path.c_str(), &st) == 0 && static_cast<uint64_t>(st.st_size) == entry.size && mtime_of(st) == entry.mtime;
+}
+
+// the distinct trigrams of a file, ascending; seen is a 2^24-bit scratch
+// bitmap, all clear before and after
+static bool file_trigrams(const std::string &path, size_t size, std::vector<uint64_t> &seen, std::vector<uint32_t> &trigrams)
+{
+    trigrams.clear();
+    if (size < 3)
+        return true;
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    const unsigned char *data = static_cast<const unsigned char *>(map);
+    uint32_t trigram = static_cast<uint32_t>(data[0]) << 8 | data[1];
+    for (size_t i = 2; i < size; ++i)
+    {
+        trigram = (trigram << 8 | data[i]) & 0xffffff;
+        uint64_t bit = uint64_t(1) << (trigram & 63);
+        if (!(seen[trigram >> 6] & bit))
+        {
+            seen[trigram >> 6] |= bit;
+            trigrams.push_back(trigram);
+        }
+    }
+    munmap(map, size);
+
+    for (uint32_t t : trigrams)
+        seen[t >> 6] = 0;
+    std::sort(trigrams.begin(), trigrams.end());
+    return true;
+}
+
+bool TrigramIndex::update(const std::string &root, const Options &opts, Summary &summary)
+{
+    TrigramIndex old;
+    old.load(root);
+    std::string base = directory_base(root);
+
+    struct Fresh
+    {
+        std::string path;
+        uint64_t size;
+        int64_t mtime;
+    };
+    std::vector<uint32_t> kept; // old ids of files unchanged since
+    std::vector<Fresh> fresh;   // files to read
+    size_t replaced = 0;        // of those, files the old index had another version of
+
+    DirWalker walker(opts);
+    walker.walk(root, true, [&](std::string path)
+                {
+        struct stat st;
+        std::string_view relative = std::string_view(path).substr(base.size());
+        if (relative == file_name || stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) ||
+            static_cast<size_t>(st.st_size) > max_file_size)
+            return;
+        auto it = old._ids.find(relative);
+        if (it != old._ids.end())
+        {
+            const Entry &entry = old._files[it->second];
+            if (entry.size == static_cast<uint64_t>(st.st_size) && entry.mtime == mtime_of(st))
+            {
+                kept.push_back(it->second);
+                return;
+            }
+            ++replaced;
+        }
+        fresh.push_back({std::string(relative), static_cast<uint64_t>(st.st_size), mtime_of(st)}); });
+
+    // kept files keep their order, so remapped posting lists stay sorted and
+    // the ids of fresh files follow all of theirs
+    std::sort(kept.begin(), kept.end());
+    std::vector<uint32_t> remap(old._files.size(), UINT32_MAX);
+    for (uint32_t i = 0; i < kept.size(); ++i)
+        remap[kept[i]] = i;
+
+    std::vector<Fresh> indexed;
+    std::vector<std::vector<uint32_t>> file_trigram_lists;
+    std::vector<uint64_t> seen(size_t(1) << 18);
+    for (auto &file : fresh)
+    {
+        std::vector<uint32_t> trigrams;
+        if (!file_trigrams(base + file.path, file.size, seen, trigrams))
+            continue;
+        file_trigram_lists.push_back(std::move(trigrams));
+        indexed.push_back(std::move(file));
+    }
+
+    summary.files = kept.size() + indexed.size();
+    summary.updated = indexed.size();
+    summary.removed = old._files.size() - kept.size() - replaced;
+    if (indexed.empty() && kept.size() == old._files.size() && old._data)
+        return true;
+
+    BinaryWriter out;
+    out.u32(magic);
+    out.u32(format_version);
+    out.u32(byte_order);
+    out.u32(static_cast<uint32_t>(kept.size() + indexed.size()));
+
+    BinaryWriter files;
+    BinaryWriter table;
+    BinaryWriter lists;
+    auto add_file = [&files](std::string_view path, uint64_t size, int64_t mtime)
+    {
+        files.u64(size);
+        files.i64(mtime);
+        files.u32(static_cast<uint32_t>(path.size()));
+        files.bytes(path.data(), path.size());
+    };
+    for (uint32_t id : kept)
+        add_file(old._files[id].path, old._files[id].size, old._files[id].mtime);
+    for (const auto &file : indexed)
+        add_file(file.path, file.size, file.mtime);
+
+    size_t trigram_count = 0;
+    auto add_posting = [&](uint32_t trigram, const std::vector<uint32_t> &ids)
+    {
+        table.u32(trigram);
+        table.u32(static_cast<uint32_t>(ids.size()));
+        table.u64(lists.out.size());
+        uint32_t previous = 0;
+        for (uint32_t id : ids)
+        {
+            lists.varint(id - previous);
+            previous = id;
+        }
+        ++trigram_count;
+    };
+
+    size_t next_old = 0;
+    auto old_trigram = [&]()
+    {
+        uint32_t trigram = UINT32_MAX;
+        if (next_old < old._trigram_count)
+            memcpy(&trigram, old._trigrams + next_old * trigram_entry_size, sizeof(trigram));
+        return trigram;
+    };
+
+    // the new postings are built a bucket of trigrams (by their top bits) at
+    // a time: each sorted file list holds a bucket in one run, and sorting
+    // just its (trigram, id) pairs stays in cache. The old table is sorted
+    // too and merges in alongside; buckets nothing uses are never visited.
+    static constexpr int bucket_shift = 12;
+    static constexpr uint32_t no_bucket = UINT32_MAX >> bucket_shift;
+    std::vector<size_t> next(indexed.size(), 0);
+    std::vector<uint64_t> pairs; // trigram << 32 | id
+    std::vector<uint32_t> ids;
+    while (true)
+    {
+        uint32_t bucket = old_trigram() >> bucket_shift;
+        for (size_t i = 0; i < indexed.size(); ++i)
+        {
+            if (next[i] < file_trigram_lists[i].size())
+                bucket = std::min(bucket, file_trigram_lists[i][next[i]] >> bucket_shift);
+        }
+        if (bucket == no_bucket)
+            break;
+
+        pairs.clear();
+        for (size_t i = 0; i < indexed.size(); ++i)
+        {
+            // read files have the highest ids, in the order of indexed
+            const auto &list = file_trigram_lists[i];
+            uint64_t id = kept.size() + i;
+            for (; next[i] < list.size() && list[next[i]] >> bucket_shift == bucket; ++next[i])
+                pairs.push_back(uint64_t(list[next[i]]) << 32 | id);
+        }
+        std::sort(pairs.begin(), pairs.end());
+
+        size_t next_pair = 0;
+        while (true)
+        {
+            uint32_t from_old = old_trigram();
+            uint32_t trigram = from_old >> bucket_shift == bucket ? from_old : UINT32_MAX;
+            if (next_pair < pairs.size())
+                trigram = std::min(trigram, static_cast<uint32_t>(pairs[next_pair] >> 32));
+            if (trigram == UINT32_MAX)
+                break;
+
+            ids.clear();
+            if (from_old == trigram)
+            {
+                for (uint32_t id : old.posting_list(trigram))
+                {
+                    if (remap[id] != UINT32_MAX)
+                        ids.push_back(remap[id]);
+                }
+                ++next_old;
+            }
+            for (; next_pair < pairs.size() && pairs[next_pair] >> 32 == trigram; ++next_pair)
+                ids.push_back(static_cast<uint32_t>(pairs[next_pair]));
+            if (!ids.empty())
+                add_posting(trigram, ids);
+        }
+    }
+
+    out.u32(static_cast<uint32_t>(trigram_count));
+    out.u64(lists.out.size());
+    out.out += files.out;
+    out.out += table.out;
+    out.out += lists.out;
+    return replace_file(base + file_name, out.out);
+}
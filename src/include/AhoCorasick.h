@@ -0,0 +1,36 @@
+#ifndef AHO_CORASICK
+#define AHO_CORASICK
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Searches for many literals at once. The trie is turned into a full DFA
+// (failure links resolved at build time) over byte classes, so every input
+// byte costs one table lookup however many literals there are. Immutable once
+// built, so one automaton can be shared by all threads.
+class AhoCorasick
+{
+public:
+    explicit AhoCorasick(const std::vector<std::string> &literals);
+
+    // pointer to the last byte of the first occurrence of any literal in
+    // [begin, end), or nullptr
+    const char *find(const char *begin, const char *end) const;
+
+    size_t state_count() const { return _accept.size(); }
+
+private:
+    uint8_t _classes[256]; // byte -> column of the transition table
+    size_t _class_count = 1;
+    // while building: target state of state * _class_count + class; once built,
+    // the row offset of the target shifted left by one, with bit 0 set when some
+    // literal ends there, so the scan loop needs no multiply and no second table
+    std::vector<int32_t> _next;
+    std::vector<uint8_t> _accept; // some literal ends in this state
+
+    int32_t add_state();
+};
+
+#endif
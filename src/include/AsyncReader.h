@@ -0,0 +1,87 @@
+#ifndef ASYNC_READER
+#define ASYNC_READER
+
+#include "Options.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// a file read ahead of its scan
+struct ReadFile
+{
+    size_t sequence = 0;
+    std::string path;
+    std::vector<char> data; // the whole file, unless fd is set
+    int fd = -1;            // open file too large (or too odd) to read whole; the receiver closes it
+    int error = 0;          // errno of a failed open; a failed read only cuts data short
+};
+
+// Reads the files of a -r walk ahead of the workers, so that open and read
+// latency (cold caches, network file systems, spinning disks) overlaps with
+// matching. With io_uring one thread keeps queue_depth opens and reads in
+// flight; without it (no kernel support, seccomp, or IO_PREAD) a pool of
+// io_threads blocks in open and pread instead. Each finished file is handed
+// to deliver on the reading thread, which should only queue it elsewhere.
+//
+// Files not yet released count against max_outstanding, which bounds the
+// memory held by read-ahead buffers.
+class AsyncReader
+{
+public:
+    using Deliver = std::function<void(ReadFile &&file)>;
+
+    AsyncReader(IoBackend backend, Deliver deliver);
+    ~AsyncReader();
+
+    AsyncReader(const AsyncReader &) = delete;
+    AsyncReader &operator=(const AsyncReader &) = delete;
+
+    // queues path; blocks while max_outstanding files are unreleased
+    void submit(size_t sequence, std::string path);
+
+    // a delivered file has been scanned and its buffer freed
+    void release();
+
+    // blocks until every submitted file has been delivered
+    void drain();
+
+    // "io_uring" or "pread"
+    const char *backend() const;
+
+    static constexpr size_t queue_depth = 64;
+    static constexpr size_t max_outstanding = 2 * queue_depth;
+    static constexpr size_t io_threads = 16;
+    static constexpr size_t whole_file_limit = 1 << 20; // larger files are mapped by the worker
+
+private:
+    struct Ring;
+
+    Deliver _deliver;
+    std::unique_ptr<Ring> _ring; // null when the pread threads are used
+    std::vector<std::thread> _threads;
+
+    std::mutex _lock;
+    std::condition_variable _work;    // a file was queued, or stopping
+    std::condition_variable _space;   // a file was released
+    std::condition_variable _drained; // the last undelivered file was delivered
+    std::deque<ReadFile> _queue;
+    size_t _outstanding = 0; // submitted and not released
+    size_t _undelivered = 0; // submitted and not delivered
+    bool _stopping = false;
+
+    // waits for queued work; false once stopping with nothing left
+    bool next(ReadFile &file, bool block);
+    void delivered(ReadFile &&file);
+
+    void run_pread();
+    void run_ring();
+    static void read_whole(ReadFile &file);
+};
+
+#endif
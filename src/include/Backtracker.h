@@ -0,0 +1,78 @@
+#ifndef BACKTRACKER
+#define BACKTRACKER
+
+#include "Nfa.h"
+#include "Pattern.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Depth-first search over an Nfa for patterns the automata cannot run
+// (NFA_BACKREF). Alternatives and slot restores live on an explicit stack, so
+// deep inputs cannot overflow the call stack, and a round of a loop that
+// consumed nothing ends the loop. Counted repetitions are plain copies in the program,
+// so x{1,3} offers the search one way to match each number of rounds instead
+// of the many a naive counter loop would retry. Backreferences can still make
+// the search exponential, hence the MatchLimits.
+class Backtracker
+{
+public:
+    explicit Backtracker(Nfa nfa);
+
+    // leftmost match in text starting at or after start; on success slots holds
+    // Nfa::slot_count byte offsets into text, npos for groups that did not take part
+    bool search(std::string_view text, size_t start, std::vector<size_t> &slots);
+
+    // a new deadline also forgets that the previous one passed
+    void set_limits(const MatchLimits &limits)
+    {
+        _limits = limits;
+        _expired = false;
+    }
+
+    // the last search() stopped at a limit, so its "no match" is not an answer
+    bool gave_up() const { return _gave_up; }
+
+    // the deadline has passed; every search() gives up until set_limits()
+    bool expired() const { return _expired; }
+
+    // states visited by all searches so far, the cost --stats reports
+    uint64_t steps() const { return _steps; }
+
+private:
+    // either an alternative still to try or a slot to restore on the way back
+    struct Frame
+    {
+        int id;
+        size_t pos;
+        int slot;     // >= 0: restore slot to value instead of exploring
+        size_t value;
+    };
+
+    Nfa _nfa;
+    std::vector<Frame> _stack;
+    std::vector<size_t> _slots;
+    // bytes a match can start with; attempts elsewhere are skipped
+    CharSet _first;
+    bool _empty_start = false; // a match may start without consuming a byte
+    bool _bol_start = false;   // ... or at a ^, which only passes at position 0
+    bool _anchored = false;    // every match starts at a ^
+    uint64_t _steps = 0;
+    MatchLimits _limits;
+    bool _gave_up = false;
+    bool _expired = false;     // the deadline has passed
+    uint64_t _step_limit = 0;  // _steps value at which the budget of this search runs out
+    uint64_t _clock_at = 0;    // _steps value at which the deadline is checked next
+    uint64_t _next_check = 0;  // the smaller of the two
+
+    // the slow path behind the single comparison in the step loop
+    bool out_of_budget();
+
+    void collect_first();
+    bool run(std::string_view text, size_t pos);
+};
+
+#endif
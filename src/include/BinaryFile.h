@@ -0,0 +1,97 @@
+#ifndef BINARY_FILE
+#define BINARY_FILE
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// The on-disk formats of the pattern cache and the trigram index: fixed-width
+// fields in host byte order, which each format guards with a byte-order mark,
+// and LEB128 varints.
+struct BinaryWriter
+{
+    std::string out;
+
+    void u32(uint32_t value) { out.append(reinterpret_cast<const char *>(&value), sizeof(value)); }
+    void i32(int value) { u32(static_cast<uint32_t>(value)); }
+    void u64(uint64_t value) { out.append(reinterpret_cast<const char *>(&value), sizeof(value)); }
+    void i64(int64_t value) { u64(static_cast<uint64_t>(value)); }
+    void bytes(const void *data, size_t size) { out.append(static_cast<const char *>(data), size); }
+    void varint(uint32_t value)
+    {
+        for (; value >= 0x80; value >>= 7)
+            out.push_back(static_cast<char>(value | 0x80));
+        out.push_back(static_cast<char>(value));
+    }
+};
+
+// every read is bounds checked; after the first failure all reads fail
+struct BinaryReader
+{
+    const char *pos;
+    const char *end;
+    bool ok = true;
+
+    bool bytes(void *data, size_t size)
+    {
+        ok = ok && static_cast<size_t>(end - pos) >= size;
+        if (ok)
+        {
+            memcpy(data, pos, size);
+            pos += size;
+        }
+        return ok;
+    }
+    uint32_t u32()
+    {
+        uint32_t value = 0;
+        bytes(&value, sizeof(value));
+        return value;
+    }
+    int i32() { return static_cast<int>(u32()); }
+    uint64_t u64()
+    {
+        uint64_t value = 0;
+        bytes(&value, sizeof(value));
+        return value;
+    }
+    int64_t i64() { return static_cast<int64_t>(u64()); }
+    std::string string(size_t size)
+    {
+        std::string value(ok && static_cast<size_t>(end - pos) >= size ? size : 0, '\0');
+        bytes(value.data(), size);
+        return value;
+    }
+    // the next size bytes, in place
+    const char *skip(size_t size)
+    {
+        ok = ok && static_cast<size_t>(end - pos) >= size;
+        const char *start = pos;
+        if (ok)
+            pos += size;
+        return ok ? start : nullptr;
+    }
+    uint32_t varint()
+    {
+        uint32_t value = 0;
+        for (int shift = 0; ok && shift < 35; shift += 7)
+        {
+            ok = pos < end;
+            if (!ok)
+                break;
+            unsigned char byte = static_cast<unsigned char>(*pos++);
+            value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        ok = false;
+        return 0;
+    }
+};
+
+// writes contents under a temporary name and renames it over path, so that
+// concurrent readers see either the old file or all of the new one
+bool replace_file(const std::string &path, const std::string &contents);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef CHAR_SET
+#define CHAR_SET
+
+#include <cstdint>
+
+// 256-bit membership table for a byte class: every test is a single load.
+// Shared by the backtracker, the NFA/DFA and the prefilter, and usable in
+// constant expressions for StaticPattern.
+struct CharSet
+{
+    uint64_t bits[4] = {0, 0, 0, 0};
+
+    constexpr bool test(unsigned char c) const { return (bits[c >> 6] >> (c & 63)) & 1; }
+    constexpr void set(unsigned char c) { bits[c >> 6] |= uint64_t(1) << (c & 63); }
+    constexpr void reset(unsigned char c) { bits[c >> 6] &= ~(uint64_t(1) << (c & 63)); }
+
+    constexpr void set_range(unsigned char lo, unsigned char hi)
+    {
+        for (unsigned c = lo; c <= hi; ++c)
+            set(static_cast<unsigned char>(c));
+    }
+
+    constexpr void set_all()
+    {
+        for (auto &word : bits)
+            word = ~uint64_t(0);
+    }
+
+    constexpr void invert()
+    {
+        for (auto &word : bits)
+            word = ~word;
+    }
+
+    constexpr void merge(const CharSet &other)
+    {
+        for (int i = 0; i < 4; ++i)
+            bits[i] |= other.bits[i];
+    }
+
+    constexpr int count() const
+    {
+        int n = 0;
+        for (auto word : bits)
+            n += __builtin_popcountll(word);
+        return n;
+    }
+
+    // the only member of a one-byte set, or -1
+    constexpr int single() const
+    {
+        if (count() != 1)
+            return -1;
+        for (int i = 0; i < 4; ++i)
+        {
+            if (bits[i])
+                return i * 64 + __builtin_ctzll(bits[i]);
+        }
+        return -1;
+    }
+
+    constexpr bool operator==(const CharSet &other) const = default;
+
+    static constexpr CharSet digits()
+    {
+        CharSet s;
+        s.set_range('0', '9');
+        return s;
+    }
+
+    // \w: [A-Za-z0-9_]
+    static constexpr CharSet word()
+    {
+        CharSet s;
+        s.set_range('a', 'z');
+        s.set_range('A', 'Z');
+        s.set_range('0', '9');
+        s.set('_');
+        return s;
+    }
+};
+
+#endif
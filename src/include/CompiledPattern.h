@@ -0,0 +1,19 @@
+#ifndef COMPILED_PATTERN
+#define COMPILED_PATTERN
+
+#include "Nfa.h"
+
+#include <string>
+
+// What matching needs from a parsed pattern, without the token tree;
+// PatternCache keeps it between runs.
+struct CompiledPattern
+{
+    Nfa program;
+    std::string required; // literal every match contains, for the Prefilter
+    std::string literal;  // the whole pattern when it is nothing but literal bytes
+    int groups = 0;       // capture groups, not counting the whole match
+    bool empty = false;   // no elements at all; never matches
+};
+
+#endif
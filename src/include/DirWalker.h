@@ -0,0 +1,53 @@
+#ifndef DIR_WALKER
+#define DIR_WALKER
+
+#include "IgnoreRules.h"
+#include "Options.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Finds the files -r searches, so that what is skipped is never opened:
+//  - hidden files and directories (names starting with '.') unless --hidden,
+//  - whatever the .gitignore and .ignore files met on the way exclude, unless
+//    --no-ignore; rules of deeper directories and of .ignore win, and an
+//    ignored directory is not entered at all,
+//  - directories matching an --exclude-dir glob,
+//  - files whose name matches an --exclude glob or, when there are any,
+//    none of the --include globs.
+// Symbolic links to files are searched, those to directories are not followed.
+class DirWalker
+{
+public:
+    // uses the hidden, no_ignore, include, exclude and exclude_dir settings of opts
+    explicit DirWalker(const Options &opts);
+
+    // calls visit with the path of every selected regular file below root, in
+    // path order when sorted is set; stops once *cancel becomes true
+    void walk(const std::string &root, bool sorted, const std::function<void(std::string)> &visit,
+              const std::atomic<bool> *cancel = nullptr);
+
+private:
+    struct Level
+    {
+        size_t prefix; // length of the directory path and its '/'
+        IgnoreRules rules;
+    };
+
+    bool _hidden;
+    bool _ignore_files;
+    std::vector<std::string> _include;
+    std::vector<std::string> _exclude;
+    std::vector<std::string> _exclude_dir;
+    std::vector<Level> _levels; // rules of the directories being walked, innermost last
+
+    void walk_dir(const std::string &dir, bool sorted, const std::function<void(std::string)> &visit,
+                  const std::atomic<bool> *cancel);
+    bool ignored(const std::string &path, bool is_dir) const;
+    bool selected(std::string_view name) const;
+};
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef REGPARSER_EXPORT
+#define REGPARSER_EXPORT
+
+// Marks what programs linking libregparser may use. The shared library is
+// built with hidden visibility, so everything not marked stays internal to it.
+#define REGPARSER_API __attribute__((visibility("default")))
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef FILE_FOLLOWER
+#define FILE_FOLLOWER
+
+#include "FileScanner.h"
+#include "Options.h"
+#include "OutputSink.h"
+#include "PatternSet.h"
+
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+// --follow: matches the lines appended to files as they grow, like
+// tail -F piped into grep but without the pipe. Following starts at the
+// current end of every file (at the start of its last line, when that is
+// still incomplete); a file that does not exist yet is picked up when it
+// is created.
+//
+// inotify watches the directory of every file (creation, renames,
+// deletion) and every open file itself (writes, also after it was renamed
+// away), so an idle follower sleeps in poll(2) and a write is matched as soon
+// as it lands. Each wake-up checks every file:
+//  - a file shorter than the bytes read from it was truncated and is read
+//    again from its start,
+//  - a path that names a new file was rotated: the old file is read to its
+//    end first, its unterminated last line is matched as it is, and the new
+//    file is read from its start.
+// Without inotify the files are checked every poll_interval instead.
+//
+// Every file has its own FileScanner, so partial lines, -B history, -n line
+// numbers (those of the file when following began, counted on across
+// rotations) and -m are per file.
+class FileFollower
+{
+public:
+    // follows opts.paths, matching with pattern and printing to sink
+    FileFollower(const Options &opts, PatternSet &pattern, OutputSink &sink);
+    ~FileFollower();
+
+    FileFollower(const FileFollower &) = delete;
+    FileFollower &operator=(const FileFollower &) = delete;
+
+    // follows until every file has reached -m, or until the first match
+    // with -q; true when any line matched. Files that cannot be opened are
+    // waited for, so this never returns early.
+    bool run();
+
+    static constexpr int poll_interval = 1000; // milliseconds, without inotify
+
+private:
+    struct Followed
+    {
+        std::string path;
+        std::string label; // output prefix, set when following several files
+        std::unique_ptr<FileScanner> scanner;
+        int fd = -1;
+        dev_t dev = 0;
+        ino_t ino = 0;
+        int wd = -1; // inotify watch on the open file
+        bool matched = false;
+    };
+
+    const Options &_opts;
+    OutputSink &_sink;
+    std::vector<Followed> _files;
+    int _inotify = -1;
+
+    // opens file.path; from its start when at_end is false, otherwise from
+    // its last line. False when the file is not there (yet).
+    bool open_file(Followed &file, bool at_end);
+    void close_file(Followed &file);
+
+    // reads and matches what was appended, handling truncation and rotation
+    void check(Followed &file);
+
+    // scans the bytes appended to the open file since the last call
+    void read_appended(Followed &file);
+
+    // sleeps until inotify reports a change, or for poll_interval without it
+    void wait();
+
+    // -m reached in every file, or -q satisfied
+    bool finished() const;
+};
+
+#endif
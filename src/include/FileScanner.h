@@ -0,0 +1,224 @@
+#ifndef FILE_SCANNER
+#define FILE_SCANNER
+
+#include "Options.h"
+#include "OutputSink.h"
+#include "PatternSet.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+// a matching line as a span of the scanned buffer; line counts from 1 at the
+// start of the scanned region and is 0 when line numbers are off
+struct LineHit
+{
+    size_t line;
+    const char *begin;
+    const char *end;
+};
+
+// Scans whole buffers instead of single lines: regular files are mmap'd,
+// pipes and stdin are read in large chunks, and line boundaries are only
+// located around the hits reported by PatternSet::find_line. Reading stops
+// as soon as the outcome for the file is decided: after the first hit for
+// -l, -L and -q, and after max_count hits otherwise.
+//
+// Context lines (-A, -B) are spans of the same buffers: lines before a hit
+// are found by scanning back from it, and a stream keeps only the last -B
+// lines of each read for the next one, so memory stays bounded by the
+// context size however long the input is. Groups whose context would
+// overlap or touch are printed as one; the others are separated by "--".
+class FileScanner
+{
+public:
+    // hits are written to sink unless set_output() redirects them
+    FileScanner(PatternSet &pattern, OutputSink *sink) : _pattern(pattern), _sink(sink) {}
+
+    // collect hits in out instead of the sink (nullptr restores the sink)
+    void set_output(std::string *out) { _out = out; }
+
+    // collect unformatted hits instead of printing them (nullptr restores printing)
+    void set_hits(std::vector<LineHit> *hits) { _hits = hits; }
+
+    // -n: prefix every line with its number; newlines are only counted when set
+    void set_line_numbers(bool line_numbers) { _line_numbers = line_numbers; }
+
+    void set_mode(OutputMode mode) { _mode = mode; }
+
+    // -A and -B, for PRINT_LINES; also turns on the "--" between groups
+    void set_context(size_t after, size_t before)
+    {
+        _context = true;
+        _after = after;
+        _before = before;
+        _before_lines.resize(before);
+    }
+
+    // the next group is printed without a "--" before it, as for the first
+    // file; for callers that separate the output of files themselves
+    void reset_context() { _printed_any = false; }
+
+    void set_max_count(size_t max_count) { _max_count = max_count; }
+
+    // scanning stops early once *cancel becomes true (-q elsewhere in a -r walk)
+    void set_cancel(const std::atomic<bool> *cancel) { _cancel = cancel; }
+
+    // -r without -a: a file whose first block contains a NUL byte is binary
+    // and scan_fd() leaves it alone, without printing anything for it
+    void set_skip_binary(bool skip_binary) { _skip_binary = skip_binary; }
+
+    // --stats: every scan_fd() adds a FileStats entry and newlines are counted
+    void set_stats(MatchStats *stats) { _stats = stats; }
+
+    // --max-steps per line and --timeout per file (seconds, 0: none) for
+    // the backtracking patterns
+    void set_limits(uint64_t max_steps, double timeout)
+    {
+        _max_steps = max_steps;
+        _timeout = timeout;
+    }
+
+    // starts the limits of a file that began at started; scan_fd() calls it,
+    // callers feeding a file to scan_buffer() piecewise call it themselves
+    void start_file(std::chrono::steady_clock::time_point started);
+
+    // lines given up on since start_file(), and whether its deadline passed
+    uint64_t abandoned() const { return _pattern.abandoned() - _abandoned_before; }
+    bool timed_out() const { return _timeout > 0 && _pattern.expired(); }
+
+    // tells on stderr what the limits cost the results for file name
+    static void report_limits(const std::string &name, uint64_t abandoned, bool timed_out, double timeout);
+
+    // newlines (with line numbers or stats on), matching lines and bytes seen
+    // since scan_fd() or reset_counts()
+    size_t lines() const { return _lines; }
+    size_t matched() const { return _matched; }
+    size_t bytes() const { return _bytes; }
+    void reset_counts()
+    {
+        _lines = 0;
+        _matched = 0;
+        _bytes = 0;
+    }
+    // --follow: lines before the offset scanning starts at, so that -n
+    // numbers the lines of the file rather than those read
+    void skip_lines(size_t lines) { _lines += lines; }
+
+    // prints one hit as "label:number:text", or a context line as
+    // "label-number-text"; empty label and number 0 are left out
+    static void write_line(OutputSink &sink, const std::string &label, size_t line, const char *begin, const char *end,
+                           char separator = ':');
+
+    // scans fd and prints what the mode asks for: hits prefixed with "label:"
+    // when label is set, "label:count" for -c, or name for -l and -L (empty
+    // name: standard input). True when any line matched, also for -L, as in
+    // GNU grep.
+    bool scan_fd(int fd, const std::string &label = "", const std::string &name = "");
+
+    // scan_fd() for a file already read into [data, data + size)
+    bool scan_data(const char *data, size_t size, const std::string &label, const std::string &name = "");
+
+    // scans [begin, end), which holds complete lines (the last one may lack its '\n')
+    bool scan_buffer(const char *begin, const char *end, const std::string &label);
+
+    // --follow: reads what fd has beyond the bytes read so far and scans the
+    // complete lines among them. A partial last line waits for the call that
+    // completes it, so writers may split lines across any number of calls.
+    bool scan_appended(int fd, const std::string &label);
+
+    // forgets the partial line and the -B history held for scan_appended(),
+    // e.g. once the file was truncated
+    void restart_stream();
+
+    // scans the partial line held back by scan_appended() as a last line,
+    // e.g. before the file is replaced by a rotated one; then restart_stream()
+    bool finish_stream(const std::string &label);
+
+private:
+    static constexpr size_t chunk_size = 1 << 20;
+    static constexpr size_t binary_probe = 8192; // bytes sniffed for a NUL by set_skip_binary
+
+    PatternSet &_pattern;
+    OutputSink *_sink;
+    std::string *_out = nullptr;
+    std::vector<LineHit> *_hits = nullptr;
+    bool _line_numbers = false;
+    OutputMode _mode = PRINT_LINES;
+    size_t _max_count = SIZE_MAX;
+    const std::atomic<bool> *_cancel = nullptr;
+    MatchStats *_stats = nullptr;
+    bool _skip_binary = false;
+    bool _binary = false; // the current file turned out to be binary
+    uint64_t _max_steps = 0;
+    double _timeout = 0;
+    uint64_t _abandoned_before = 0;
+    size_t _lines = 0;
+    size_t _matched = 0;
+    size_t _bytes = 0;
+    // streamed input: _filled bytes of _buffer are read, of which the first
+    // _scanned are lines kept for -B and the rest await their newline
+    std::vector<char> _buffer;
+    size_t _filled = 0;
+    size_t _scanned = 0;
+
+    // context state; the pointers refer to the buffer being scanned
+    bool _context = false;
+    size_t _after = 0;
+    size_t _before = 0;
+    const char *_history = nullptr;     // first byte still available for -B lines
+    const char *_printed_end = nullptr; // just past the last printed line of this file
+    size_t _printed_line = 0;           // its number, with line numbers on
+    size_t _after_left = 0;             // -A lines still owed to the last hit
+    bool _printed_any = false;          // the next group needs a "--" unless it is adjacent
+    std::vector<std::pair<const char *, const char *>> _before_lines; // newest first
+
+    // what scan_fd() and scan_data() do before and after scanning the file
+    std::chrono::steady_clock::time_point begin_file();
+    bool end_file(std::chrono::steady_clock::time_point started, const std::string &label, const std::string &name);
+
+    bool scan_mapped(int fd, size_t size, const std::string &label, bool &found);
+    bool is_binary(const char *begin, size_t size)
+    {
+        _binary = _skip_binary && memchr(begin, 0, std::min(size, binary_probe)) != nullptr;
+        return _binary;
+    }
+    bool scan_stream(int fd, const std::string &label);
+    // read(2) into _buffer after the _filled bytes, growing it when full
+    ssize_t read_chunk(int fd);
+    // scans the complete lines among n freshly read bytes and drops those not
+    // needed as -B history
+    bool scan_read(size_t n, const std::string &label);
+    void emit(const char *begin, const char *end, const std::string &label, size_t line, char separator = ':');
+    void emit_summary(const std::string &text);
+
+    // prints a line of a context group, preceded by "--" when it does not
+    // follow the previously printed line
+    void print_line(const char *begin, const char *end, const std::string &label, size_t line, char separator);
+    // the -B lines before the hit starting at line_begin, line being its number
+    void print_before(const char *line_begin, const std::string &label, size_t line);
+    // the -A lines still owed, up to limit
+    void print_after(const char *limit, const std::string &label);
+    // first byte of the last -B lines before end, kept when a stream buffer is refilled
+    const char *history_start(const char *begin, const char *end) const;
+
+    // -m was reached but the last hit still has -A lines to print
+    bool trailing_context() const
+    {
+        return _after_left > 0 && !(_cancel && _cancel->load(std::memory_order_relaxed)) && !timed_out();
+    }
+
+    // no further hit can change the output for the current file, or its time is up
+    bool done() const
+    {
+        size_t limit = _mode == PRINT_LINES || _mode == PRINT_COUNT ? _max_count : std::min<size_t>(_max_count, 1);
+        return _matched >= limit || (_cancel && _cancel->load(std::memory_order_relaxed)) || timed_out();
+    }
+};
+
+#endif
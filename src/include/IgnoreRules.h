@@ -0,0 +1,49 @@
+#ifndef IGNORE_RULES
+#define IGNORE_RULES
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// shell glob: '*' and '?' stop at '/', "**" crosses it, [...] is a byte class
+// ('!' or '^' negates it) and '\' quotes the next byte
+bool glob_match(std::string_view pattern, std::string_view text);
+
+typedef enum
+{
+    IGNORE_NONE,    // no rule matched
+    IGNORE_SKIP,    // the last matching rule ignores the path
+    IGNORE_INCLUDE, // the last matching rule is a "!" negation
+} IgnoreMatch;
+
+// The rules of one .gitignore or .ignore file, in gitignore syntax: blank
+// lines and '#' comments are skipped, '!' negates, a trailing '/' only
+// matches directories, and a pattern containing another '/' is anchored to
+// the directory of the file while one without matches a name at any depth.
+class IgnoreRules
+{
+public:
+    // appends the rules of the file at path; false when it cannot be read
+    bool load(const std::string &path);
+
+    void add(std::string_view line);
+
+    bool empty() const { return _rules.empty(); }
+
+    // path is relative to the directory holding the file; the last rule
+    // that matches decides
+    IgnoreMatch match(std::string_view path, bool is_dir) const;
+
+private:
+    struct Rule
+    {
+        std::string glob;
+        bool negated = false;
+        bool dir_only = false;
+        bool anchored = false; // matched against the whole path, not only its last name
+    };
+
+    std::vector<Rule> _rules;
+};
+
+#endif
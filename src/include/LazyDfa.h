@@ -0,0 +1,66 @@
+#ifndef LAZY_DFA
+#define LAZY_DFA
+
+#include "Nfa.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Runs an Nfa as a DFA whose states are built on demand and cached.
+// Every input byte costs one table lookup once its transition is known,
+// so a line is matched in O(n * m) time even when the cache is cold.
+class LazyDfa
+{
+public:
+    explicit LazyDfa(Nfa nfa);
+
+    // true when any substring of [begin, end) matches the pattern
+    bool match(const char *begin, const char *end);
+
+    // scans a buffer of '\n'-terminated lines and returns a pointer into the
+    // first matching line (possibly at its '\n'), or nullptr
+    const char *find_line(const char *begin, const char *end);
+
+    // states built so far, counting those dropped by cache flushes
+    uint64_t states_built() const { return _built; }
+    uint64_t flushes() const { return _flushes; }
+
+private:
+    struct DState
+    {
+        std::vector<int> nfa_states; // sorted epsilon closure
+        bool bol = false;
+        bool is_match = false;
+        bool is_dead = false;
+        bool accepts_at_eol = false;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const std::vector<int> &key) const;
+    };
+
+    static constexpr size_t max_states = 4096;
+
+    Nfa _nfa;
+    std::vector<DState> _states;
+    std::vector<int32_t> _trans; // _states.size() * 256, -1 when not built yet
+    std::unordered_map<std::vector<int>, int, KeyHash> _index;
+    int _initial = -1;
+    uint64_t _built = 0;
+    uint64_t _flushes = 0;
+
+    // scratch reused across closures
+    std::vector<int> _stack;
+    std::vector<uint32_t> _visited;
+    uint32_t _generation = 0;
+
+    void closure(std::vector<int> &set, bool bol, bool eol);
+    int add_state(std::vector<int> set, bool bol);
+    int next_state(int state, unsigned char byte);
+    void flush_cache();
+};
+
+#endif
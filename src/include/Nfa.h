@@ -0,0 +1,81 @@
+#ifndef NFA
+#define NFA
+
+#include "CharSet.h"
+
+#include <cstddef>
+#include <vector>
+
+struct TokenList;
+struct Re;
+
+typedef enum
+{
+    NFA_BYTE,  // consume one byte contained in sets[set]
+    NFA_SPLIT, // epsilon to out (preferred) and out1
+    NFA_BOL,   // epsilon, only at the beginning of the line
+    NFA_EOL,   // epsilon, only at the end of the line
+    NFA_SAVE,  // epsilon, records the current position in capture slot `slot`
+    NFA_PROGRESS, // epsilon to out when the position moved since the SAVE of `slot`, else to out1
+    NFA_BACKREF,  // consume the text last captured by group `slot`
+    NFA_MATCH,
+} NfaOp;
+
+struct NfaState
+{
+    NfaOp op = NFA_MATCH;
+    int out = -1;
+    int out1 = -1;
+    int set = -1;
+    int slot = -1; // NFA_SAVE: 2 * group for its start, 2 * group + 1 for its end;
+                   // NFA_BACKREF: the group
+};
+
+// Thompson NFA built from the parsed TokenList tree.
+// States are addressed by index so the program can be copied freely.
+class Nfa
+{
+public:
+    // returns false when the program would grow past max_states
+    bool compile(const TokenList &token_list);
+
+    // one program matching wherever any of the programs matches, tried in
+    // order; their slots overlap, so it is only fit for the LazyDfa
+    bool merge(const std::vector<const Nfa *> &programs);
+
+    // replaces every NFA_BACKREF with a loop over any bytes but '\n', which
+    // matches a superset of the lines the program matches and is regular,
+    // so the LazyDfa can rule lines out before the Backtracker runs
+    void relax_backrefs();
+
+    // routes around the NFA_SAVE states no NFA_BACKREF or loop guard reads,
+    // for engines that only answer whether a line matches; the bypassed
+    // states stay in place, unreachable
+    void drop_captures();
+
+    std::vector<NfaState> states;
+    std::vector<CharSet> sets;
+    int start = -1;
+    // capture slots used by NFA_SAVE; slots 0 and 1 bracket the whole match,
+    // loop guards of NFA_PROGRESS come after those of the groups
+    int slot_count = 2;
+    // NFA_BACKREF is not regular: such programs only run on the Backtracker
+    bool has_backrefs = false;
+
+    // counted repetitions copy their element, so nesting them multiplies
+    static constexpr size_t max_states = 1 << 20;
+
+private:
+    int add_state(NfaOp op, int out = -1, int out1 = -1, int set = -1);
+    int add_save(int slot, int next);
+    int add_split(const Re &re, int body, int exit);
+    int compile_list(const TokenList &token_list, int next);
+    int compile_re(const Re &re, int next);
+    int compile_repeat(const Re &re, int min, int max, int next);
+    int compile_loop(const Re &re, int next);
+    int compile_atom(const Re &re, int next);
+    static bool nullable(const Re &re);
+    static int max_group(const TokenList &token_list);
+};
+
+#endif
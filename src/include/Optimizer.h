@@ -0,0 +1,24 @@
+#ifndef OPTIMIZER
+#define OPTIMIZER
+
+#include <string>
+
+struct TokenList;
+
+// Rewrites a parsed pattern into an equivalent one that compiles to fewer
+// NFA states, so every engine has less to follow per byte:
+//  - leading elements shared by consecutive alternatives are factored out,
+//    (abc|abd) becomes (ab(c|d)) and (ab|abc) becomes (abc??),
+//  - alternatives that are one byte or class each become one class,
+//    (c|d) becomes [cd],
+//  - runs of literal bytes become STRING nodes.
+// Only elements that match in exactly one way are factored and alternatives
+// keep their order, so the preferred match and every capture span stay those
+// of the pattern as written.
+void optimize_pattern(TokenList &token_list);
+
+// the literal the Prefilter checks first: the longest run of plain bytes on
+// the pattern's mandatory path, empty when there is none
+std::string required_literal(const TokenList &token_list);
+
+#endif
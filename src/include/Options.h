@@ -0,0 +1,72 @@
+#ifndef OPTIONS
+#define OPTIONS
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// what is printed for every scanned file
+typedef enum
+{
+    PRINT_LINES,        // every matching line
+    PRINT_COUNT,        // -c: the number of matching lines
+    PRINT_MATCHING,     // -l: the file name if any line matches
+    PRINT_NON_MATCHING, // -L: the file name if no line matches
+    PRINT_NOTHING,      // -q: exit status only
+} OutputMode;
+
+// how -r reads the files it finds
+typedef enum
+{
+    IO_AUTO,  // io_uring when the kernel allows it, IO_PREAD otherwise
+    IO_URING, // one thread keeping many opens and reads in flight
+    IO_PREAD, // a pool of threads blocking in open and pread
+    IO_SYNC,  // each worker opens and maps its own files
+} IoBackend;
+
+struct Options
+{
+    std::vector<std::string> patterns; // any line matching one of them is printed
+    std::vector<std::string> paths;
+
+    bool recursive = false;
+    size_t jobs = 0;         // 0: one per hardware thread; also splits large files
+    bool sort_files = false; // -r output in path order instead of completion order
+    bool line_buffered = false;
+    bool line_numbers = false; // -n
+    OutputMode mode = PRINT_LINES;
+    size_t max_count = SIZE_MAX; // -m: stop reading a file after this many matching lines
+    size_t after_context = 0;    // -A (or -C): lines printed after every matching line
+    size_t before_context = 0;   // -B (or -C): lines printed before every matching line
+    bool context = false;        // any of -A, -B and -C, even with 0 lines, separates groups with "--"
+    std::string cache_dir;       // --cache-dir: keep compiled patterns here between runs
+    // -r: what the DirWalker skips and whether binary files are searched
+    bool hidden = false;                  // --hidden: also walk names starting with '.'
+    bool no_ignore = false;               // --no-ignore: disregard .gitignore and .ignore files
+    bool text = false;                    // -a: search files with NUL bytes too
+    IoBackend io = IO_AUTO;               // --io=auto|uring|pread|sync
+    std::vector<std::string> include;     // --include: only files whose name matches one of these globs
+    std::vector<std::string> exclude;     // --exclude: skip files whose name matches
+    std::vector<std::string> exclude_dir; // --exclude-dir: skip directories whose name matches
+    bool stats = false;          // --stats: report per-file and per-engine counters on stderr
+    bool follow = false;         // --follow: keep matching what is appended to the files, across rotation
+    // backtracking patterns (those with backreferences) give up on a line
+    // after --max-steps states (0: never) and on a file after --timeout seconds (0: never)
+    uint64_t max_steps = 10000000;
+    double timeout = 0;
+    // "index DIR...": write the trigram index of every DIR instead of searching
+    bool index = false;
+    bool no_index = false; // --no-index: -r reads every file even where an index could rule it out
+};
+
+// Parses the command line into opts. Flags may appear anywhere before "--".
+// Patterns come from every -e PATTERN and -f FILE (one per line); without
+// those the pattern is the first positional argument. -E is accepted and
+// ignored, as extended syntax is the only one.
+// The remaining positional arguments are paths; after the "index"
+// subcommand all of them are.
+// Reports problems on std::cerr and returns false.
+bool parse_options(int argc, char *argv[], Options &opts);
+
+#endif
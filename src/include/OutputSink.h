@@ -0,0 +1,58 @@
+#ifndef OUTPUT_SINK
+#define OUTPUT_SINK
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// Batches output into one large buffer and hands it to write(2) only when the
+// buffer is full, on flush() and on destruction. With line buffering enabled
+// every completed line is flushed, for interactive use such as tailing logs.
+// Not synchronized: concurrent writers must serialize access themselves.
+class OutputSink
+{
+public:
+    explicit OutputSink(int fd, size_t capacity = 1 << 16);
+    ~OutputSink();
+
+    OutputSink(const OutputSink &) = delete;
+    OutputSink &operator=(const OutputSink &) = delete;
+
+    void set_line_buffered(bool line_buffered) { _line_buffered = line_buffered; }
+
+    void write(const char *data, size_t size);
+    void write(std::string_view text) { write(text.data(), text.size()); }
+    void put(char c)
+    {
+        if (_used == _buffer.size())
+            flush();
+        _buffer[_used++] = c;
+    }
+
+    // terminates a line; flushes when line buffered
+    void end_line()
+    {
+        put('\n');
+        if (_line_buffered)
+            flush();
+    }
+
+    // marks the end of a block of complete lines (e.g. one file's hits)
+    void end_block()
+    {
+        if (_line_buffered)
+            flush();
+    }
+
+    void flush();
+
+private:
+    int _fd;
+    std::vector<char> _buffer;
+    size_t _used = 0;
+    bool _line_buffered = false;
+
+    void write_all(const char *data, size_t size);
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef PARALLEL_SEARCH
+#define PARALLEL_SEARCH
+
+#include "AsyncReader.h"
+#include "DirWalker.h"
+#include "FileScanner.h"
+#include "Options.h"
+#include "OutputSink.h"
+#include "PatternSet.h"
+#include "ThreadPool.h"
+#include "TrigramIndex.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Recursive search (-r): the calling thread walks the tree with a DirWalker,
+// an AsyncReader reads the files it finds ahead of time, and every file is
+// scanned as a task on a work-stealing pool. Files whose first block holds a
+// NUL byte are taken for binary and skipped unless -a.
+//
+// The workers share one compiled Pattern per pattern; each owns a PatternSet
+// (the Matchers and their DFA caches) and a scanner, and collects a file's
+// hits in a private buffer that is written out in one piece, so lines of
+// different files never interleave.
+//
+// A directory with a trigram index (see TrigramIndex) is still walked, but
+// files the index rules out for the patterns are not opened.
+//
+// A single large file is split into newline-aligned chunks instead. Workers
+// take chunks in file order and keep their hits as spans of the mapping; a
+// chunk is written once every chunk before it has been, which is also when
+// the number of lines before it, and so its line numbers, become known.
+class ParallelSearch
+{
+public:
+    // uses the jobs, sort_files (emit files in path order instead of
+    // completion order) and line_numbers settings of opts; the workers'
+    // PatternSets reuse the compiled patterns of patterns, which must have
+    // parsed successfully
+    ParallelSearch(const Options &opts, const PatternSet &patterns, OutputSink &sink);
+
+    // searches every regular file below root (or root itself); true when any line matched
+    bool search(const std::string &root);
+
+    // files at least this large are worth splitting across the workers
+    static constexpr size_t chunk_size = 8 << 20;
+    bool splits(size_t size) const { return _splittable && _workers.size() > 1 && size >= 2 * chunk_size; }
+
+    // scans the regular file fd of the given size in chunks; hits are printed
+    // in file order, prefixed with "label:" when label is set; name is the
+    // file name for --stats
+    bool search_large_file(int fd, size_t size, const std::string &label, const std::string &name);
+
+    // --stats: what every worker saw, engines included
+    void collect_stats(MatchStats &stats) const;
+
+private:
+    struct Worker
+    {
+        std::unique_ptr<PatternSet> pattern;
+        std::unique_ptr<FileScanner> scanner;
+        std::string output;
+        MatchStats stats;
+    };
+
+    struct Chunk
+    {
+        std::vector<LineHit> hits;
+        size_t lines = 0; // newlines in the chunk, counted with line numbers on
+        bool done = false;
+    };
+
+    struct ChunkedFile
+    {
+        const char *data;
+        size_t size;
+        const std::string &label;
+        std::vector<Chunk> chunks;
+        std::atomic<size_t> next_chunk{0};
+        std::atomic<bool> found{false};
+        std::atomic<size_t> matched{0};
+        size_t next_to_emit = 0; // guarded by _output_lock
+        size_t lines_before = 0; // lines in the chunks written so far, guarded by _output_lock
+    };
+
+    OutputSink &_sink;
+    bool _sort_files;
+    OutputMode _mode;
+    // -l, -L, -q and -m stop at a point in the file that chunks cannot know
+    // about, and context lines may cross chunk boundaries
+    bool _splittable;
+    bool _context;               // -A, -B or -C with PRINT_LINES
+    bool _wrote_context = false; // guarded by _output_lock
+    bool _stats;
+    double _timeout; // --timeout, also for split files as a whole
+    MatchStats _chunked_stats; // files split across the workers
+    DirWalker _walker;
+    std::vector<Worker> _workers;
+    ThreadPool _pool;
+    std::atomic<bool> _found{false};
+    std::atomic<bool> _cancel{false}; // -q: a hit was found, the rest is skipped
+    // what the index of a root must allow for a file to be read; unused with
+    // --no-index, for -c and -L, which report files without matches too, and
+    // when the patterns have no literals
+    TrigramQuery _query;
+    bool _use_index;
+
+    std::mutex _output_lock;
+    size_t _next_sequence = 0;            // submitted files
+    size_t _next_to_emit = 0;             // sort_files: first file not written yet
+    std::map<size_t, std::string> _ready; // sort_files: finished out of order
+
+    // reads files ahead of the workers unless IO_SYNC; declared last so it
+    // stops before the pool it feeds
+    std::unique_ptr<AsyncReader> _reader;
+
+    void submit(std::string path);
+    void scan(size_t worker, size_t sequence, const std::string &path);
+    void scan_read(size_t worker, ReadFile &file);
+    void publish(size_t sequence, std::string &text);
+    void write_file_output(const std::string &text);
+
+    static size_t chunk_boundary(const ChunkedFile &file, size_t offset);
+    void scan_chunks(size_t worker, ChunkedFile &file);
+    void publish_chunk(ChunkedFile &file, size_t index);
+};
+
+#endif
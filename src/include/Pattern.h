@@ -0,0 +1,143 @@
+#ifndef PATTERN
+#define PATTERN
+
+#include "Export.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The library's public interface, installed with Export.h as the only
+// headers it needs: it names no engine, so engines can change without
+// breaking programs built against it.
+
+struct CompiledPattern; // the compiled program, internal to the library
+
+// byte offsets into the searched text; groups that did not take part stay at npos
+struct MatchSpan
+{
+    size_t begin = std::string_view::npos;
+    size_t end = std::string_view::npos;
+
+    bool matched() const { return begin != std::string_view::npos; }
+    size_t length() const { return end - begin; }
+};
+
+struct MatchResult
+{
+    // groups[0] is the whole match, groups[n] capture group n
+    std::vector<MatchSpan> groups;
+
+    const MatchSpan &span() const { return groups[0]; }
+};
+
+// Bounds on backtracking. A search that reaches one gives up and reports no
+// match, so a pathological pattern costs at most max_steps per line.
+struct MatchLimits
+{
+    uint64_t max_steps = 0; // states visited per search() call; 0: unlimited
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+};
+
+// what one engine did; filled from counters the engines keep
+// unconditionally, since a plain increment on a per-thread object is cheap
+// enough for release builds
+struct EngineStats
+{
+    std::string engine;    // "dfa", "backtrack", "aho-corasick" or "union dfa"
+    std::string patterns;  // the pattern it runs, or how many
+    std::string prefilter; // required literal checked first, empty when none
+    uint64_t candidates = 0; // lines the prefilter let through
+    uint64_t confirmed = 0;  // of those, lines that matched
+    uint64_t steps = 0;      // states visited by the backtracker
+    uint64_t states = 0;     // automaton states built
+    uint64_t flushes = 0;    // DFA cache resets after hitting its size limit
+    uint64_t abandoned = 0;  // lines the backtracker ran out of steps on (--max-steps)
+};
+
+// A compiled pattern. It never changes once built, so one instance can serve
+// any number of threads, each matching through a Matcher of its own:
+//
+//     std::shared_ptr<const Pattern> pattern = Pattern::compile("ERROR \\d+");
+//     ...
+//     Matcher matcher(pattern); // per thread, reused for every line
+//     if (matcher.match(line)) ...
+class REGPARSER_API Pattern
+{
+public:
+    // nullptr when source is not a valid pattern or compiles too large
+    static std::shared_ptr<const Pattern> compile(const std::string &source);
+
+    // a pattern compiled earlier, e.g. by a previous run through PatternCache;
+    // for the library itself, which alone sees CompiledPattern
+    Pattern(std::string source, CompiledPattern compiled);
+    ~Pattern();
+
+    Pattern(const Pattern &) = delete;
+    Pattern &operator=(const Pattern &) = delete;
+
+    const std::string &source() const;
+    const CompiledPattern &compiled() const;
+
+    // number of capture groups, not counting the whole match
+    size_t group_count() const;
+
+    // true when lines are matched by the linear-time lazy DFA, false when
+    // backreferences need the backtracker
+    bool uses_dfa() const;
+
+private:
+    friend class Matcher;
+
+    struct Impl; // the programs and the prefilter, see Pattern.cpp
+    std::unique_ptr<const Impl> _impl;
+};
+
+// Everything that changes while matching a Pattern: the DFA state caches, the
+// VM and backtracker stacks, the limits and the --stats counters. Cheap to
+// create, but not thread-safe; every thread needs its own.
+class REGPARSER_API Matcher
+{
+public:
+    explicit Matcher(std::shared_ptr<const Pattern> pattern);
+    ~Matcher();
+
+    Matcher(const Matcher &) = delete;
+    Matcher &operator=(const Matcher &) = delete;
+
+    const Pattern &pattern() const { return *_pattern; }
+
+    // true when any part of line matches; line needs no terminator
+    bool match(std::string_view line);
+
+    // leftmost match in line at or after byte offset start, with its capture
+    // spans; ^ and $ still refer to the ends of line
+    bool find(std::string_view line, size_t start, MatchResult &result);
+
+    // returns a pointer into the first matching line of a '\n'-separated buffer, or nullptr
+    const char *find_line(const char *begin, const char *end);
+
+    // bounds the backtracker; lines it gives up on count as not matching
+    void set_limits(const MatchLimits &limits);
+
+    // lines given up on so far because of the step budget; the deadline is
+    // reported by expired() instead
+    uint64_t abandoned() const;
+
+    // the deadline passed: find_line() and match() skip all further lines
+    bool expired() const;
+
+    // engine, prefilter and work counters for --stats
+    EngineStats stats() const;
+
+private:
+    struct Engines; // see Pattern.cpp
+    std::shared_ptr<const Pattern> _pattern;
+    std::unique_ptr<Engines> _engines;
+};
+
+#endif
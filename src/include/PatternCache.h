@@ -0,0 +1,42 @@
+#ifndef PATTERN_CACHE
+#define PATTERN_CACHE
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct CompiledPattern;
+
+// Compiled patterns kept on disk between runs, so short-lived invocations with
+// the same pattern list skip parsing and NFA construction. There is one file
+// per list, named after a hash of the list and holding the list itself, so a
+// hash collision reads as a miss rather than as someone else's program. The
+// programs are flat arrays of 32-bit fields whose states refer to each other
+// by index, so the file is mapped and copied out without any fixups. Entries
+// are written under a temporary name and renamed into place, which keeps
+// concurrent runs from ever reading half an entry.
+class PatternCache
+{
+public:
+    // dir is created by the first store()
+    explicit PatternCache(std::string dir);
+
+    // one CompiledPattern per pattern, from the entry for exactly this list
+    bool load(const std::vector<std::string> &patterns, std::vector<CompiledPattern> &compiled) const;
+
+    // best effort: an entry that cannot be written only costs later runs a compile
+    bool store(const std::vector<std::string> &patterns, const std::vector<const CompiledPattern *> &compiled) const;
+
+    // bumped whenever the file layout or the meaning of a compiled program changes
+    static constexpr uint32_t format_version = 2;
+
+private:
+    std::string _dir;
+
+    // everything that decides the compiled programs; no option changes
+    // compilation yet, but one that does must become part of the key
+    static std::string key(const std::vector<std::string> &patterns);
+    std::string path(const std::string &key) const;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef PATTERN_SET
+#define PATTERN_SET
+
+#include "AhoCorasick.h"
+#include "Pattern.h"
+#include "Stats.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class LazyDfa;
+class PatternCache;
+
+// Every pattern given with -e/-f (or the single positional one), compiled
+// into as few engines as possible so each line is scanned once:
+//  - two or more plain literals share one Aho-Corasick automaton,
+//  - the other patterns without backreferences share one union LazyDfa
+//    (a lone pattern keeps its own Matcher, prefilter included),
+//  - patterns with backreferences run on their own backtrackers.
+// Owns mutable DFA caches, so every thread needs its own PatternSet; the
+// compiled Patterns and the literal automaton are read-only, so the sets of
+// other threads can be built from the first one without compiling again.
+class PatternSet
+{
+public:
+    // with shared, a set of the same patterns that parsed successfully,
+    // parse() reuses its compiled Patterns and literal automaton
+    explicit PatternSet(const std::vector<std::string> &patterns, const PatternSet *shared = nullptr);
+    ~PatternSet();
+
+    PatternSet(const PatternSet &) = delete;
+    PatternSet &operator=(const PatternSet &) = delete;
+
+    // takes the compiled patterns from cache when it has them and stores them
+    // there otherwise; must be set before parse()
+    void set_cache(const PatternCache *cache) { _cache = cache; }
+
+    // bounds the backtracking patterns; may be changed between files
+    void set_limits(const MatchLimits &limits);
+
+    // lines some backtracking pattern ran out of steps on; they count as not matching
+    uint64_t abandoned() const;
+
+    // the deadline of the current limits passed in some backtracking pattern
+    bool expired() const;
+
+    // compiles every pattern once; on failure invalid_pattern() names the culprit
+    bool parse();
+    const std::string &invalid_pattern() const { return _invalid; }
+
+    // true when any pattern matches somewhere in line
+    bool match(std::string_view line);
+
+    // returns a pointer into the first line of a '\n'-separated buffer that any
+    // pattern matches, or nullptr. Calls for one buffer must move forward and
+    // keep its end; reset() before the first call for every buffer.
+    const char *find_line(const char *begin, const char *end);
+
+    // forgets the hits find_line cached for the previous buffer
+    void reset();
+
+    // one EngineStats per engine, appended to stats.engines
+    void collect_stats(MatchStats &stats) const;
+
+private:
+    typedef enum
+    {
+        ENGINE_LITERALS,
+        ENGINE_DFA,
+        ENGINE_PATTERN,
+    } EngineKind;
+
+    struct Engine
+    {
+        EngineKind kind;
+        size_t patterns = 1;          // how many patterns it runs
+        Matcher *pattern = nullptr;   // ENGINE_PATTERN
+        const char *next = nullptr;   // start of its next matching line, cached by find_line
+        bool searched = false;        // next is valid for the current buffer
+    };
+
+    std::vector<std::string> _sources;
+    std::vector<std::shared_ptr<const Pattern>> _compiled;
+    std::vector<std::unique_ptr<Matcher>> _patterns;
+    std::shared_ptr<const AhoCorasick> _literals;
+    const PatternSet *_shared = nullptr;
+    const PatternCache *_cache = nullptr;
+    MatchLimits _limits;
+    std::unique_ptr<LazyDfa> _dfa;
+    std::vector<Engine> _engines;
+    std::string _invalid;
+    bool _parsed = false;
+    bool _valid = false;
+
+    // compiles _sources into _compiled; on failure sets _invalid
+    bool compile();
+
+    const char *engine_find(Engine &engine, const char *begin, const char *end);
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef PIKE_VM
+#define PIKE_VM
+
+#include "Nfa.h"
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// Simulates an Nfa in lock step, one thread per NFA state, and carries the
+// capture slots along with every thread. Threads are kept in priority order,
+// so the result is the leftmost match with the same preferences as the
+// backtracker (greedy quantifiers, earlier alternatives first), found in
+// O(n * m) time. Slower than the LazyDfa, so it only runs on lines that are
+// already known to match when positions are asked for. A loop is not entered
+// again from a state it reached without consuming input, so a group that can
+// match the empty string may report an earlier iteration than a backtracker.
+// Programs with NFA_BACKREF need the Backtracker instead.
+class PikeVm
+{
+public:
+    explicit PikeVm(Nfa nfa);
+
+    // leftmost match in text starting at or after start; on success slots holds
+    // Nfa::slot_count byte offsets into text, npos for groups that did not take part
+    bool search(std::string_view text, size_t start, std::vector<size_t> &slots);
+
+private:
+    // sparse set of NFA states in insertion (= priority) order, with the
+    // capture slots of every member
+    struct ThreadList
+    {
+        std::vector<int> dense;
+        std::vector<int> sparse;
+        std::vector<size_t> slots; // slot_count entries per NFA state
+
+        bool contains(int id) const;
+        void insert(int id);
+        void clear() { dense.clear(); }
+    };
+
+    // the epsilon walk either explores a state or undoes a SAVE on the way back
+    struct Frame
+    {
+        int id;
+        int slot;      // >= 0: restore slot to value instead of exploring
+        size_t value;
+    };
+
+    Nfa _nfa;
+    size_t _slot_count;
+    ThreadList _clist;
+    ThreadList _nlist;
+    std::vector<Frame> _stack;
+    std::vector<size_t> _scratch; // slots of the thread being followed
+
+    void add_thread(ThreadList &list, int id, std::string_view text, size_t pos);
+};
+
+#endif
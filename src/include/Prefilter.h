@@ -0,0 +1,30 @@
+#ifndef PREFILTER
+#define PREFILTER
+
+#include "Export.h"
+
+#include <cstddef>
+#include <string>
+
+// A literal that every match of the pattern must contain, e.g. "ERROR" in
+// `ERROR \d+`. Lines without it are skipped before any engine runs; the
+// search itself uses an SSE2/AVX2 first/last-byte kernel when available.
+class REGPARSER_API Prefilter
+{
+public:
+    // returns false for an empty literal, which cannot filter anything
+    bool build(const std::string &literal);
+
+    const std::string &literal() const { return _literal; }
+
+    // first occurrence of the literal in [begin, end), or nullptr
+    const char *find(const char *begin, const char *end) const;
+
+private:
+    using FindFn = const char *(*)(const char *haystack, size_t n, const char *needle, size_t k);
+
+    std::string _literal;
+    FindFn _find = nullptr;
+};
+
+#endif
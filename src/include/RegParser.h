@@ -1,14 +1,15 @@
 #ifndef REG_PARSER
 #define REG_PARSER
 
-#include <vector>
-#include <unordered_map>
-#include <string>
-#include <cstring>
-#include <cctype>
-#include <iostream>
-#include <stack>
 #include <memory>
+#include <stack>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CharSet.h"
+#include "CompiledPattern.h"
+#include "Pattern.h"
 
 // #define DEBUG
 
@@ -17,7 +18,8 @@ typedef enum
     NONE,
     PLUS,
     STAR,
-    MARK
+    MARK,
+    REPEAT // {m}, {m,} and {m,n}: repeat_min and repeat_max
 } Quantifier;
 
 typedef enum
@@ -30,6 +32,7 @@ typedef enum
     LIST,
     ALT,
     BACKREF,
+    STRING, // literal bytes in ccl, formed by optimize_pattern
     ETK,
 } RegType;
 
@@ -41,57 +44,102 @@ struct Re
     std::string ccl;
     bool isNegative = false;
     Quantifier quantifier = NONE;
+    int repeat_min = 0;
+    int repeat_max = -1; // -1: unbounded
+    bool lazy = false;   // quantifier followed by '?'
     int captured_gp_id = -1;
-    std::vector<TokenList> alternatives;
+    std::vector<TokenList> alternatives{};
+    CharSet set{}; // bytes matched by SINGLE_CHAR, DIGIT, ALPHANUM and LIST
 };
 
 struct TokenList
 {
     TokenList *parent = nullptr;
-    std::vector<Re> regex;
-};
-
-struct CaptureGroup
-{
-    const char *start = nullptr;
-    size_t length = 0;
+    std::vector<Re> regex{};
 };
 
+// Parses a pattern and compiles it into a Pattern, then matches through a
+// Matcher of its own: the convenient form for one thread. Threads sharing a
+// pattern share the Pattern from pattern() and each make their own Matcher.
 class RegParser
 {
 public:
-    explicit RegParser(const std::string &pattern) : _pattern(pattern.c_str()), _begin(pattern.c_str()), _end(_begin + pattern.size())
-    {
-        gp_stack[&token_list] = 0;
-    };
+    explicit RegParser(const std::string &pattern);
+    // pattern as compiled by an earlier parse(); parse() only builds the engines
+    RegParser(const std::string &pattern, CompiledPattern compiled);
+    ~RegParser();
 
-    // disable copy and assignment (pointer conflict)
+    // disable copy, move and assignment (token lists hold pointers into this object)
     RegParser(const RegParser &) = delete;
     RegParser &operator=(const RegParser &) = delete;
+    RegParser(RegParser &&) = delete;
+    RegParser &operator=(RegParser &&) = delete;
 
-    // Move constructor and assignment
-    RegParser(RegParser &&) = default;
-    RegParser &operator=(RegParser &&) = default;
-
+    // parses the pattern once; later calls return the cached result
     bool parse();
-    bool match(const std::string &input_line);
+
+    // parses and compiles the pattern without building any engine; nullptr
+    // when it is invalid
+    std::shared_ptr<const Pattern> pattern();
+
+    // true when any part of line matches; line needs no terminator
+    bool match(std::string_view line);
+
+    // leftmost match in line at or after byte offset start, with its capture
+    // spans; ^ and $ still refer to the ends of line
+    bool find(std::string_view line, size_t start, MatchResult &result);
+
+    // returns a pointer into the first matching line of a '\n'-separated buffer, or nullptr
+    const char *find_line(const char *begin, const char *end);
+
+    const std::string &source() const { return _source; }
+
+    // number of capture groups, not counting the whole match
+    size_t group_count() const { return _result ? _result->group_count() : 0; }
+
+    // valid after a successful parse()
+    const CompiledPattern &compiled() const { return _result ? _result->compiled() : _compiled; }
+
+    // engine, prefilter and work counters for --stats
+    EngineStats stats() const;
+
+    // true when matching runs on the linear-time lazy DFA instead of the backtracker
+    bool uses_dfa() const { return _result && _result->uses_dfa(); }
+
+    // bounds the backtracker; lines it gives up on count as not matching
+    void set_limits(const MatchLimits &limits);
+
+    // lines given up on so far because of the step budget; the deadline is
+    // reported by expired() instead
+    uint64_t abandoned() const { return _matcher ? _matcher->abandoned() : 0; }
+
+    // the deadline passed: find_line() and match() skip all further lines
+    bool expired() const { return _matcher && _matcher->expired(); }
+
+    // counted repetitions are expanded into copies of their element, so the
+    // bounds are capped to keep the compiled program small
+    static constexpr int max_repeat = 1000;
 
     TokenList token_list;
-    std::unordered_map<TokenList *, int> gp_stack;
 
 private:
+    std::string _source;
     const char *_pattern{nullptr};
     const char *_begin{nullptr};
     const char *_end{nullptr};
     int next_capture_id = 1;
+    bool _parsed = false;
+    bool _valid = false;
+    bool _precompiled = false;
+    CompiledPattern _compiled; // until pattern() hands it to _result
+
+    std::shared_ptr<const Pattern> _result;
+    std::unique_ptr<Matcher> _matcher; // set by parse()
+    MatchLimits _limits;
 
     // parsing state
     std::stack<TokenList *> parser_gp_stack;
 
-    // runtime state for matching
-    std::unordered_map<int, CaptureGroup> captures;
-    std::unordered_map<int, const char *> group_start;
-
     // Parsing methods
     bool isEof() const { return _pattern >= _end; }
     bool consume();
@@ -102,29 +150,16 @@ private:
     Re parseCharacterClass();
     Re parseGroup();
     void applyQuantifiers(Re &element);
+    bool parseRepeat(Re &element);
 
     Re makeRe(RegType type, const std::string &ccl = "", bool isNegative = false);
 
-    // matching methods
-    void sync_index(TokenList *tl, int idx) { gp_stack[tl] = idx; }
-
-    bool match_current(const char *c, const std::vector<Re> &regex, int idx);
-    bool match_from_position(const char **start_pos, const TokenList &token_list, int idx, bool is_backtracking = false);
-    bool can_match_next_here(const char *start_pos, const TokenList &token_list, int idx, bool is_backtracking = false);
-    bool matchCharacterInList(char c, const Re &ListRe) const;
-
-    bool match_one_or_more(const char **c, const TokenList &token_list, int idx);
-    bool match_alt_one_or_more(const char **c, const TokenList &token_list, int idx);
-    bool match_zero_or_one(const char **c, const TokenList &token_list, int idx);
-    bool match_alt_zero_or_one(const char **c, const TokenList &token_list, int idx);
+    bool parseClassItem(CharSet &set);
 
-    // quantifier handlers
-    int handle_quantified_match(const char **c, const TokenList &token_list, int idx);
-    bool handle_plus_quantifier(const char **c, const TokenList &token_list, int idx);
-    bool handle_question_quantifier(const char **c, const TokenList &token_list, int idx);
-    bool handle_no_quantifier(const char **c, const TokenList &token_list, int idx);
-    bool handle_alternation(const char **c, const TokenList &token_list, int idx);
-    bool handle_single_match(const char **c, const TokenList &token_list, int idx);
+    // parses _source into token_list
+    bool parse_tokens();
+    // fills _compiled from token_list
+    bool compile();
 
     // utility
     inline bool at_begin() const { return _pattern == _begin; }
@@ -132,4 +167,4 @@ private:
     inline size_t offset() const { return static_cast<size_t>(_pattern - _begin); }
 };
 
-#endif
\ No newline at end of file
+#endif
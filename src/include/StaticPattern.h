@@ -0,0 +1,706 @@
+#ifndef STATIC_PATTERN
+#define STATIC_PATTERN
+
+#include "CharSet.h"
+#include "Prefilter.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// a string literal as a template argument: StaticPattern<"ab+c">
+template <size_t N>
+struct FixedString
+{
+    char text[N] = {};
+
+    constexpr FixedString(const char (&literal)[N]) { std::copy_n(literal, N, text); }
+    constexpr std::string_view view() const { return {text, N - 1}; }
+};
+
+// Compile-time half of StaticPattern. The pattern is parsed with the grammar
+// of RegParser::parseElement, compiled back to front into an NFA as
+// Nfa::compile does (without capture slots, which a DFA never reads) and then
+// turned into a complete DFA by the subset construction LazyDfa performs on
+// demand. Everything runs in constant evaluation; a pattern that cannot be
+// compiled reaches one of the functions below that are not constexpr, and the
+// compiler names it in the error.
+class StaticCompiler
+{
+public:
+    static constexpr int max_repeat = 1000;       // as RegParser::max_repeat
+    static constexpr size_t max_nfa_states = 4096; // keeps constant evaluation within compiler limits
+    static constexpr size_t max_states = 1024;    // DFA states; each takes a 256-entry row
+
+    enum : uint8_t
+    {
+        STATE_MATCH = 1,     // a match ended at or before this point
+        STATE_EOL_MATCH = 2, // a match ends here if the line does
+        STATE_DEAD = 4,      // nothing on the rest of the line can match
+    };
+
+    struct Sizes
+    {
+        size_t states;
+        size_t required;
+    };
+
+    template <size_t States, size_t Required>
+    struct Table
+    {
+        using Index = std::conditional_t<(States <= 256), uint8_t, uint16_t>;
+
+        std::array<Index, States * 256> next{}; // state * 256 + byte; state 0 is the initial one
+        std::array<uint8_t, States> flags{};
+        std::array<char, Required + 1> required{}; // literal every match contains, as for the Prefilter
+        bool empty = false;                        // no elements at all; never matches
+    };
+
+    static consteval Sizes sizes(std::string_view pattern)
+    {
+        Dfa dfa = build(pattern);
+        return {dfa.flags.size(), dfa.required.size()};
+    }
+
+    template <size_t States, size_t Required>
+    static consteval Table<States, Required> table(std::string_view pattern)
+    {
+        Dfa dfa = build(pattern);
+        Table<States, Required> table;
+        for (size_t state = 0; state < States; ++state)
+        {
+            table.flags[state] = dfa.flags[state];
+            for (size_t byte = 0; byte < 256; ++byte)
+            {
+                int next = dfa.next[state * dfa.class_count + dfa.classes[byte]];
+                table.next[state * 256 + byte] = static_cast<typename Table<States, Required>::Index>(next);
+            }
+        }
+        std::copy(dfa.required.begin(), dfa.required.end(), table.required.begin());
+        table.empty = dfa.empty;
+        return table;
+    }
+
+private:
+    // reached in constant evaluation only; see the class comment
+    static void invalid_pattern() {}
+    static void backreferences_need_RegParser() {}
+    static void pattern_too_large() {}
+
+    // the part of Nfa.h's NfaOp and NfaState a DFA follows: captures and
+    // backreferences never reach a StaticPattern
+    enum Op
+    {
+        OP_BYTE,
+        OP_SPLIT,
+        OP_BOL,
+        OP_EOL,
+        OP_MATCH,
+    };
+
+    struct State
+    {
+        Op op = OP_MATCH;
+        int out = -1;
+        int out1 = -1;
+        int set = -1;
+    };
+
+    struct Node
+    {
+        enum Type
+        {
+            SET,
+            BOL,
+            EOL,
+            GROUP
+        } type = SET;
+        CharSet set;
+        int min = 1; // {1,1} when unquantified
+        int max = 1; // -1: unbounded
+        std::vector<std::vector<int>> alternatives; // GROUP: node indices
+    };
+
+    // RegParser::parseElement and its helpers, minus the capture bookkeeping
+    struct Parser
+    {
+        std::string_view pattern;
+        size_t pos = 0;
+        std::vector<Node> nodes{};
+
+        constexpr bool eof() const { return pos >= pattern.size(); }
+        constexpr bool check(char c) const { return !eof() && pattern[pos] == c; }
+        constexpr bool match(char c)
+        {
+            if (!check(c))
+                return false;
+            ++pos;
+            return true;
+        }
+        constexpr unsigned char next()
+        {
+            if (eof())
+                invalid_pattern();
+            return static_cast<unsigned char>(pattern[pos++]);
+        }
+
+        constexpr int add(Node node)
+        {
+            nodes.push_back(std::move(node));
+            return static_cast<int>(nodes.size()) - 1;
+        }
+
+        constexpr std::vector<int> parse()
+        {
+            std::vector<int> list;
+            while (!eof())
+                list.push_back(element());
+            return list;
+        }
+
+        constexpr int element()
+        {
+            Node node;
+            if (match('^'))
+            {
+                node.type = Node::BOL;
+                return add(std::move(node));
+            }
+            if (match('$'))
+            {
+                node.type = Node::EOL;
+                return add(std::move(node));
+            }
+            if (match('('))
+                return group();
+            if (match('['))
+                node.set = char_class();
+            else if (match('\\'))
+            {
+                unsigned char escaped = next();
+                if (escaped == 'w')
+                    node.set = CharSet::word();
+                else if (escaped == 'd')
+                    node.set = CharSet::digits();
+                else if (escaped >= '0' && escaped <= '9')
+                    backreferences_need_RegParser();
+                else
+                    node.set.set(escaped);
+            }
+            else
+            {
+                unsigned char byte = next();
+                if (byte == '.')
+                {
+                    node.set.set_all();
+                    node.set.reset('\n');
+                }
+                else
+                    node.set.set(byte);
+            }
+            quantifiers(node);
+            return add(std::move(node));
+        }
+
+        constexpr int group()
+        {
+            Node node;
+            node.type = Node::GROUP;
+            node.alternatives.emplace_back();
+            while (true)
+            {
+                if (eof())
+                    invalid_pattern();
+                if (match('|'))
+                    node.alternatives.emplace_back();
+                else if (match(')'))
+                    break;
+                else
+                {
+                    int id = element();
+                    node.alternatives.back().push_back(id);
+                }
+            }
+            quantifiers(node);
+            return add(std::move(node));
+        }
+
+        constexpr CharSet char_class()
+        {
+            CharSet set;
+            bool negated = match('^');
+            while (!eof() && !check(']'))
+                class_item(set);
+            if (!match(']'))
+                invalid_pattern();
+            if (negated)
+            {
+                set.invert();
+                set.reset('\n');
+            }
+            return set;
+        }
+
+        constexpr void class_item(CharSet &set)
+        {
+            unsigned char lo = next();
+            if (lo == '\\')
+            {
+                lo = next();
+                if (lo == 'd' || lo == 'w')
+                {
+                    set.merge(lo == 'd' ? CharSet::digits() : CharSet::word());
+                    return;
+                }
+            }
+            if (check('-') && pos + 1 < pattern.size() && pattern[pos + 1] != ']')
+            {
+                ++pos;
+                unsigned char hi = next();
+                if (hi == '\\')
+                    hi = next();
+                if (hi < lo)
+                    invalid_pattern();
+                set.set_range(lo, hi);
+                return;
+            }
+            set.set(lo);
+        }
+
+        constexpr void quantifiers(Node &node)
+        {
+            if (match('+'))
+                node.max = -1;
+            else if (match('*'))
+            {
+                node.min = 0;
+                node.max = -1;
+            }
+            else if (match('?'))
+                node.min = 0;
+            else if (!check('{') || !repeat(node))
+                return;
+            // laziness changes which match is reported, never whether there is one
+            match('?');
+        }
+
+        constexpr bool repeat(Node &node)
+        {
+            size_t p = pos + 1;
+            auto read_count = [&](int &count)
+            {
+                size_t digits = p;
+                count = 0;
+                while (p < pattern.size() && pattern[p] >= '0' && pattern[p] <= '9')
+                {
+                    count = std::min(count * 10 + (pattern[p] - '0'), max_repeat + 1);
+                    ++p;
+                }
+                return p > digits;
+            };
+
+            int min = 0;
+            int max = 0;
+            bool has_min = read_count(min);
+            bool has_comma = p < pattern.size() && pattern[p] == ',';
+            if (has_comma)
+            {
+                ++p;
+                if (!read_count(max))
+                    max = -1;
+            }
+            else
+                max = min;
+            if (p >= pattern.size() || pattern[p] != '}' || (!has_min && !has_comma))
+                return false;
+            pos = p + 1;
+            if (min > max_repeat || max > max_repeat || (max >= 0 && min > max))
+                invalid_pattern();
+            node.min = min;
+            node.max = max;
+            return true;
+        }
+    };
+
+    // required_literal of Optimizer.h over the parsed nodes
+    struct Literals
+    {
+        const std::vector<Node> &nodes;
+        std::string run{};
+        std::string best{};
+
+        constexpr void flush()
+        {
+            if (run.size() > best.size())
+                best = run;
+            run.clear();
+        }
+
+        constexpr void collect(const std::vector<int> &list)
+        {
+            for (int id : list)
+            {
+                const Node &node = nodes[id];
+                int byte = node.type == Node::SET ? node.set.single() : -1;
+                bool once = node.min == 1 && node.max == 1;
+                bool repeated = node.min >= 1 && !once;
+                bool single_group = node.type == Node::GROUP && node.alternatives.size() == 1;
+
+                if (byte >= 0 && once)
+                    run.push_back(static_cast<char>(byte));
+                else if (byte >= 0 && repeated)
+                {
+                    run.push_back(static_cast<char>(byte));
+                    flush();
+                }
+                else if (single_group && once)
+                    collect(node.alternatives[0]);
+                else if (single_group && repeated)
+                {
+                    flush();
+                    collect(node.alternatives[0]);
+                    flush();
+                }
+                else
+                    flush();
+            }
+        }
+    };
+
+    // Nfa::compile, back to front
+    struct Builder
+    {
+        const std::vector<Node> &nodes;
+        std::vector<State> states{};
+        std::vector<CharSet> sets{};
+
+        constexpr int add(Op op, int out = -1, int out1 = -1, int set = -1)
+        {
+            if (states.size() >= max_nfa_states)
+                pattern_too_large();
+            states.push_back({op, out, out1, set});
+            return static_cast<int>(states.size()) - 1;
+        }
+
+        constexpr int list(const std::vector<int> &ids, int next)
+        {
+            for (auto it = ids.rbegin(); it != ids.rend(); ++it)
+                next = element(nodes[*it], next);
+            return next;
+        }
+
+        constexpr int element(const Node &node, int next)
+        {
+            int exit = next;
+            int min = node.min;
+            if (node.max < 0)
+            {
+                int loop = add(OP_SPLIT, -1, next);
+                states[loop].out = atom(node, loop);
+                next = loop;
+            }
+            else
+            {
+                for (int i = min; i < node.max; ++i)
+                    next = add(OP_SPLIT, atom(node, next), exit);
+            }
+            for (int i = 0; i < min; ++i)
+                next = atom(node, next);
+            return next;
+        }
+
+        constexpr int atom(const Node &node, int next)
+        {
+            switch (node.type)
+            {
+            case Node::BOL:
+                return add(OP_BOL, next);
+            case Node::EOL:
+                return add(OP_EOL, next);
+            case Node::GROUP:
+            {
+                int entry = -1;
+                for (auto it = node.alternatives.rbegin(); it != node.alternatives.rend(); ++it)
+                {
+                    int alt = list(*it, next);
+                    entry = entry < 0 ? alt : add(OP_SPLIT, alt, entry);
+                }
+                return entry < 0 ? next : entry;
+            }
+            case Node::SET:
+            default:
+                sets.push_back(node.set);
+                return add(OP_BYTE, next, -1, static_cast<int>(sets.size()) - 1);
+            }
+        }
+    };
+
+    struct Dfa
+    {
+        std::vector<int> next; // state * class_count + class
+        std::vector<uint8_t> flags;
+        std::array<uint8_t, 256> classes{}; // bytes no NFA set tells apart share a class
+        int class_count = 0;
+        std::string required;
+        bool empty = false;
+    };
+
+    // the subset construction of LazyDfa, run to completion
+    struct Subsets
+    {
+        const std::vector<State> &states;
+        const std::vector<CharSet> &sets;
+        int start;
+        Dfa &dfa;
+
+        // states are told apart by their NFA states and by whether ^ still holds
+        std::vector<std::vector<int>> keys{};
+        std::vector<bool> bols{};
+        std::vector<std::vector<int>> buckets = std::vector<std::vector<int>>(1024);
+        std::vector<int> stack{};
+        std::vector<uint32_t> visited = std::vector<uint32_t>(states.size());
+        uint32_t generation = 0;
+
+        // LazyDfa::closure: the sorted BYTE, EOL and MATCH states reachable from set
+        constexpr void closure(std::vector<int> &set, bool bol, bool eol)
+        {
+            ++generation;
+            stack = set;
+            set.clear();
+            while (!stack.empty())
+            {
+                int id = stack.back();
+                stack.pop_back();
+                if (id < 0 || visited[id] == generation)
+                    continue;
+                visited[id] = generation;
+                const State &st = states[id];
+                switch (st.op)
+                {
+                case OP_SPLIT:
+                    stack.push_back(st.out1);
+                    stack.push_back(st.out);
+                    break;
+                case OP_BOL:
+                    if (bol)
+                        stack.push_back(st.out);
+                    break;
+                case OP_EOL:
+                    set.push_back(id);
+                    if (eol)
+                        stack.push_back(st.out);
+                    break;
+                default:
+                    set.push_back(id);
+                    break;
+                }
+            }
+            std::sort(set.begin(), set.end());
+        }
+
+        constexpr int state(std::vector<int> key, bool bol)
+        {
+            size_t hash = bol;
+            for (int id : key)
+                hash = hash * 31 + static_cast<size_t>(id);
+            std::vector<int> &bucket = buckets[hash % buckets.size()];
+            for (int id : bucket)
+            {
+                if (bols[id] == bol && keys[id] == key)
+                    return id;
+            }
+            if (keys.size() >= max_states)
+                pattern_too_large();
+
+            bool has_byte = false;
+            uint8_t flags = 0;
+            for (int id : key)
+            {
+                has_byte |= states[id].op == OP_BYTE;
+                flags |= states[id].op == OP_MATCH ? STATE_MATCH : 0;
+            }
+            std::vector<int> at_eol = key;
+            closure(at_eol, bol, true);
+            for (int id : at_eol)
+                flags |= states[id].op == OP_MATCH ? STATE_EOL_MATCH : 0;
+            if (!has_byte && !flags)
+                flags = STATE_DEAD;
+
+            int id = static_cast<int>(keys.size());
+            keys.push_back(std::move(key));
+            bols.push_back(bol);
+            bucket.push_back(id);
+            dfa.flags.push_back(flags);
+            return id;
+        }
+
+        constexpr void run(const std::vector<int> &representative)
+        {
+            std::vector<int> initial{start};
+            closure(initial, true, false);
+            state(std::move(initial), true);
+            std::vector<int> next;
+            for (size_t current = 0; current < keys.size(); ++current)
+            {
+                for (int byte : representative)
+                {
+                    next.clear();
+                    for (int id : keys[current])
+                    {
+                        const State &st = states[id];
+                        if (st.op == OP_BYTE && sets[st.set].test(static_cast<unsigned char>(byte)))
+                            next.push_back(st.out);
+                    }
+                    // unanchored search: a new attempt may begin after every byte
+                    next.push_back(start);
+                    closure(next, false, false);
+                    dfa.next.push_back(state(next, false));
+                }
+            }
+        }
+    };
+
+    static constexpr Dfa build(std::string_view pattern)
+    {
+        Parser parser{pattern};
+        std::vector<int> top = parser.parse();
+
+        Dfa dfa;
+        dfa.empty = top.empty();
+        Literals literals{parser.nodes};
+        literals.collect(top);
+        literals.flush();
+        dfa.required = literals.best;
+
+        Builder builder{parser.nodes};
+        int start = builder.list(top, builder.add(OP_MATCH));
+
+        // one transition per class of bytes that no NFA set tells apart
+        std::vector<int> representative;
+        for (int byte = 0; byte < 256; ++byte)
+        {
+            size_t cls = 0;
+            for (; cls < representative.size(); ++cls)
+            {
+                auto same = [&](const CharSet &set)
+                { return set.test(static_cast<unsigned char>(byte)) == set.test(static_cast<unsigned char>(representative[cls])); };
+                if (std::all_of(builder.sets.begin(), builder.sets.end(), same))
+                    break;
+            }
+            if (cls == representative.size())
+                representative.push_back(byte);
+            dfa.classes[byte] = static_cast<uint8_t>(cls);
+        }
+        dfa.class_count = static_cast<int>(representative.size());
+
+        Subsets subsets{builder.states, builder.sets, start, dfa};
+        subsets.run(representative);
+        return dfa;
+    }
+};
+
+// A pattern fixed at compile time, for programs that embed their patterns and
+// link the matcher as a library:
+//
+//     using ErrorLine = StaticPattern<"ERROR [[]worker-\\d+]">;
+//     if (ErrorLine::match(line)) ...
+//
+// The pattern is parsed and compiled to a complete DFA during the build, so
+// matching is a table load per byte with nothing to parse, build or look up
+// at run time, and match() can run in constant expressions too. A line
+// matches exactly when RegParser::match accepts it. Invalid patterns,
+// backreferences and patterns needing more than StaticCompiler::max_states
+// DFA states fail to compile; large counted repetitions may also need a higher
+// -fconstexpr-ops-limit (GCC) or -fconstexpr-steps (Clang).
+template <FixedString Source>
+class StaticPattern
+{
+public:
+    static constexpr std::string_view source() { return Source.view(); }
+
+    // true when any part of line matches; line needs no terminator
+    static constexpr bool match(std::string_view line)
+    {
+        if (_table.empty)
+            return false;
+        if constexpr (_sizes.required > 0)
+        {
+            if consteval
+            {
+                if (line.find(std::string_view(_table.required.data(), _sizes.required)) == std::string_view::npos)
+                    return false;
+            }
+            else
+            {
+                // the SIMD search of RegParser, set up on first use
+                static const Prefilter prefilter = []
+                {
+                    Prefilter built;
+                    built.build(std::string(_table.required.data(), _sizes.required));
+                    return built;
+                }();
+                if (!prefilter.find(line.data(), line.data() + line.size()))
+                    return false;
+            }
+        }
+
+        size_t state = 0;
+        for (char c : line)
+        {
+            uint8_t flags = _table.flags[state];
+            if (flags & (StaticCompiler::STATE_MATCH | StaticCompiler::STATE_DEAD))
+                return flags & StaticCompiler::STATE_MATCH;
+            state = _table.next[state * 256 + static_cast<unsigned char>(c)];
+        }
+        return _table.flags[state] & (StaticCompiler::STATE_MATCH | StaticCompiler::STATE_EOL_MATCH);
+    }
+
+    // start of the first matching line of a '\n'-separated buffer, or nullptr
+    static const char *find_line(const char *begin, const char *end)
+    {
+        if (_table.empty)
+            return nullptr;
+        const char *line = begin;
+        size_t state = 0;
+        for (const char *p = begin; p < end; ++p)
+        {
+            unsigned char byte = static_cast<unsigned char>(*p);
+            if (byte == '\n')
+            {
+                if (_table.flags[state] & StaticCompiler::STATE_EOL_MATCH)
+                    return line;
+                state = 0;
+                line = p + 1;
+                continue;
+            }
+            if (_table.flags[state] & StaticCompiler::STATE_MATCH)
+                return line;
+            state = _table.next[state * 256 + byte];
+            if (_table.flags[state] & StaticCompiler::STATE_MATCH)
+                return line;
+            if (_table.flags[state] & StaticCompiler::STATE_DEAD)
+            {
+                // nothing can match on the rest of this line
+                p = static_cast<const char *>(memchr(p, '\n', static_cast<size_t>(end - p)));
+                if (!p)
+                    return nullptr;
+                state = 0;
+                line = p + 1;
+            }
+        }
+        // a final line without its '\n'
+        return line < end && (_table.flags[state] & StaticCompiler::STATE_EOL_MATCH) ? line : nullptr;
+    }
+
+private:
+    static constexpr StaticCompiler::Sizes _sizes = StaticCompiler::sizes(Source.view());
+    static constexpr auto _table = StaticCompiler::table<_sizes.states, _sizes.required>(Source.view());
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef STATS
+#define STATS
+
+#include "Pattern.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct FileStats
+{
+    std::string name;
+    uint64_t bytes = 0;
+    uint64_t lines = 0;
+    uint64_t matches = 0; // matching lines
+    double seconds = 0;
+};
+
+// --stats: collected per thread and merged once the search is over
+struct MatchStats
+{
+    std::vector<FileStats> files;
+    std::vector<EngineStats> engines;
+    double read_seconds = 0; // in read(2); mapped files fault their pages in while matching
+
+    // engines are matched up by position, which holds for PatternSets built
+    // from the same pattern list
+    void merge(const MatchStats &other);
+
+    // per-file table, totals and per-engine counters
+    void print(std::ostream &out) const;
+};
+
+#endif
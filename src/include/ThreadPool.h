@@ -0,0 +1,57 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool where every worker owns a task deque. Workers pop their own
+// work LIFO and, when empty, steal FIFO from the other workers, so long-running
+// files on one worker do not leave the rest of the pool idle.
+class ThreadPool
+{
+public:
+    // a task receives the index of the worker running it, for per-worker scratch state
+    using Task = std::function<void(size_t worker)>;
+
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t size() const { return _queues.size(); }
+
+    void submit(Task task);
+
+    // blocks until every submitted task has finished
+    void wait();
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _workers;
+
+    std::mutex _idle_lock;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    size_t _pending = 0; // submitted but not finished, guarded by _idle_lock
+    std::atomic<size_t> _queued{0}; // submitted, not yet picked up
+    size_t _next_queue = 0;
+    bool _stopping = false;
+
+    bool pop_task(size_t worker, Task &task);
+    void run(size_t worker);
+};
+
+#endif
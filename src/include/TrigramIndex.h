@@ -0,0 +1,115 @@
+#ifndef TRIGRAM_INDEX
+#define TRIGRAM_INDEX
+
+#include "Options.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct TokenList;
+
+// What the trigrams (three consecutive bytes) of a file must satisfy for the
+// file to hold a match: `ERROR \d+` needs "ERR", "RRO", "ROR" and "OR ", and
+// (foo|bar)x needs "foo" or "bar", then "oox" or "arx". QUERY_ALL is the
+// answer for patterns without usable literals, which every file may match.
+struct TrigramQuery
+{
+    typedef enum
+    {
+        QUERY_ALL,     // any file
+        QUERY_NONE,    // no file, e.g. for the empty pattern
+        QUERY_TRIGRAM, // files containing trigram
+        QUERY_AND,     // files satisfying every child
+        QUERY_OR,      // files satisfying some child
+    } Op;
+
+    Op op = QUERY_ALL;
+    uint32_t trigram = 0;
+    std::vector<TrigramQuery> children;
+
+    // derived from the exact strings on the mandatory paths of a parsed pattern
+    static TrigramQuery from_tokens(const TokenList &token_list);
+
+    // files any of patterns may match; QUERY_ALL when one of them is invalid
+    static TrigramQuery from_patterns(const std::vector<std::string> &patterns);
+
+    // simplified: ALL and NONE children are folded into their parent
+    static TrigramQuery all_of(std::vector<TrigramQuery> queries);
+    static TrigramQuery any_of(std::vector<TrigramQuery> queries);
+};
+
+// The "index" subcommand keeps file_name in the root of a tree: for every
+// file the DirWalker selects, its size and mtime, and for every trigram the
+// sorted ids of the files containing it. Posting lists are delta-coded varints
+// behind a sorted table, so the file is mapped and looked up in place.
+//
+// Searches stay exact however stale the index is: a file is only left
+// unopened when it was indexed with its current size and mtime and the
+// trigrams of the pattern rule it out. Files added or changed since, or too
+// large to index, are searched as usual. update() rereads only those.
+class TrigramIndex
+{
+public:
+    TrigramIndex() = default;
+    ~TrigramIndex();
+
+    TrigramIndex(const TrigramIndex &) = delete;
+    TrigramIndex &operator=(const TrigramIndex &) = delete;
+
+    // maps the index of directory root; false when there is none, or it is
+    // damaged or of another format
+    bool load(const std::string &root);
+
+    // selects the files query allows; until then every file is selected
+    void select(const TrigramQuery &query);
+
+    // path, as the DirWalker reports it below root, is indexed with its
+    // current size and mtime and not selected, so it cannot match; or it is
+    // the index itself
+    bool excludes(const std::string &path) const;
+
+    // what update() did
+    struct Summary
+    {
+        size_t files = 0;   // indexed files
+        size_t updated = 0; // of those, read again because they are new or changed
+        size_t removed = 0; // entries dropped for files that are gone
+    };
+
+    // builds the index of root, or refreshes the one there, over the files a
+    // DirWalker with opts selects; false when it cannot be written
+    static bool update(const std::string &root, const Options &opts, Summary &summary);
+
+    static constexpr const char *file_name = ".grepindex";
+    static constexpr uint32_t format_version = 1;
+    static constexpr size_t max_file_size = size_t(256) << 20; // larger files are always searched
+
+private:
+    struct Entry
+    {
+        std::string_view path; // relative to root, inside the mapping
+        uint64_t size;
+        int64_t mtime; // nanoseconds
+    };
+
+    const char *_data = nullptr;
+    size_t _size = 0;
+    std::string _base; // root with a trailing '/'
+    std::vector<Entry> _files;
+    std::unordered_map<std::string_view, uint32_t> _ids;
+    const char *_trigrams = nullptr; // the sorted trigram table
+    size_t _trigram_count = 0;
+    const char *_postings = nullptr;
+    size_t _postings_size = 0;
+    std::vector<bool> _selected; // empty: all
+
+    // the ids of the files containing trigram, ascending
+    std::vector<uint32_t> posting_list(uint32_t trigram) const;
+    std::vector<uint32_t> evaluate(const TrigramQuery &query) const;
+};
+
+#endif
@@ -0,0 +1,114 @@
+// Matching time must grow linearly with the input. For every pattern, the
+// best time over a line of n bytes is compared with that over a line of 4n
+// bytes; a backtracking matcher takes exponential or at best quadratic time
+// on these, so a ratio above max_ratio fails the test (linear is about 4).
+//
+//   linear_time [--size KB]
+
+#include "Pattern.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+
+static constexpr double max_ratio = 10;
+static constexpr int runs = 5;
+
+// the line is prefix, n times fill, then tail; the prefix holds the literal
+// the pattern requires, so that the prefilter lets the line through to the
+// engines
+struct Case
+{
+    const char *pattern;
+    const char *prefix;
+    char fill;
+    const char *tail;
+    bool matches;
+};
+
+static const Case cases[] = {
+    {"(a*)*b$", "b", 'a', "", false},
+    {"(a*)*b", "", 'a', "b", true},
+    {"(a+)+b$", "b", 'a', "c", false},
+    {"(a|aa)*c$", "c", 'a', "", false},
+    {"(a*?)*?b$", "b", 'a', "", false},
+    {"(a|a?)+b$", "b", 'a', "", false},
+    {"a{1,20}a{1,20}b$", "b", 'a', "", false},
+    {"(x+x+)+y$", "y", 'x', "", false},
+    {"(a?){25}a{25}$", "", 'a', "b", false},
+};
+
+static double best_of(const std::function<void()> &run)
+{
+    double best = 1e9;
+    for (int i = 0; i < runs; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+// times match(), and find() with its spans, on a line of size bytes
+static bool time_case(const Case &c, size_t size, double &match_time, double &find_time)
+{
+    auto pattern = Pattern::compile(c.pattern);
+    if (!pattern)
+    {
+        std::printf("FAIL %s: does not compile\n", c.pattern);
+        return false;
+    }
+    Matcher matcher(pattern);
+    std::string line = c.prefix + std::string(size, c.fill) + c.tail;
+
+    bool matched = false;
+    bool found = false;
+    MatchResult result;
+    match_time = best_of([&]
+                         { matched = matcher.match(line); });
+    find_time = best_of([&]
+                        { found = matcher.find(line, 0, result); });
+    if (matched != c.matches || found != c.matches)
+    {
+        std::printf("FAIL %s on %zu bytes: match() %d, find() %d, expected %d\n", c.pattern, line.size(), matched,
+                    found, c.matches);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t size = 256 << 10;
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--size") == 0)
+            size = std::strtoul(argv[++i], nullptr, 10) << 10;
+    }
+
+    bool ok = true;
+    for (const Case &c : cases)
+    {
+        double match_n, find_n, match_4n, find_4n;
+        if (!time_case(c, size, match_n, find_n) || !time_case(c, 4 * size, match_4n, find_4n))
+        {
+            ok = false;
+            continue;
+        }
+        // below a few microseconds the clock, not the matcher, decides the ratio
+        double match_ratio = match_4n / std::max(match_n, 1e-5);
+        double find_ratio = find_4n / std::max(find_n, 1e-5);
+        bool linear = match_ratio <= max_ratio && find_ratio <= max_ratio;
+        std::printf("%s %-18s match %8.3f -> %8.3f ms (x%.1f)  find %8.3f -> %8.3f ms (x%.1f)\n",
+                    linear ? "ok  " : "FAIL", c.pattern, match_n * 1e3, match_4n * 1e3, match_ratio, find_n * 1e3,
+                    find_4n * 1e3, find_ratio);
+        ok &= linear;
+    }
+    return ok ? 0 : 1;
+}
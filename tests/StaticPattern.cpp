@@ -0,0 +1,150 @@
+// StaticCompiler repeats the grammar of RegParser and the compilation of
+// Nfa and LazyDfa in constant evaluation; this keeps the two in step. Every
+// pattern below goes through StaticPattern and through Pattern/Matcher, and
+// both must agree on match() for every line of a random corpus drawn from the
+// pattern's own bytes, and on the lines find_line() picks out of all of them.
+
+#include "Pattern.h"
+#include "StaticPattern.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+// the consteval path of match(), without the Prefilter
+static_assert(StaticPattern<"a(b|c)+d">::match("xxabcbd"));
+static_assert(!StaticPattern<"a(b|c)+d">::match("xxad"));
+static_assert(StaticPattern<"^\\d{2,3}$">::match("123"));
+static_assert(!StaticPattern<"^\\d{2,3}$">::match("1234"));
+
+static constexpr int lines_per_pattern = 4000;
+
+// lines every corpus starts with, for patterns random bytes rarely match
+static const char *const samples[] = {
+    "", "a", "ab", "abc", "aab", "aaab", "abab", "abcx", "cdcde", "acd",
+    "xaaby", "x.a+", "0a", "a1", "ccbc", "abcc", "1.2.3.4", "2.3.4x", "127.0.0.1", "10.200.3.44x",
+};
+
+static std::vector<std::string> random_lines(std::string_view pattern, unsigned seed)
+{
+    std::string alphabet = "ab0. -x";
+    for (char c : pattern)
+    {
+        if (c >= ' ' && c <= '~' && alphabet.find(c) == std::string::npos)
+            alphabet += c;
+    }
+
+    std::mt19937 random(seed);
+    std::vector<std::string> lines(std::begin(samples), std::end(samples));
+    while (lines.size() < lines_per_pattern)
+    {
+        std::string line(random() % 16, '\0');
+        for (char &c : line)
+            c = alphabet[random() % alphabet.size()];
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// the indexes of the lines of buffer that find_line reports, in order
+template <typename Find>
+static std::vector<size_t> found_lines(const std::string &buffer, Find find_line)
+{
+    std::vector<size_t> found;
+    const char *begin = buffer.data();
+    const char *end = begin + buffer.size();
+    const char *pos = begin;
+    while (pos < end)
+    {
+        const char *hit = find_line(pos, end);
+        if (!hit)
+            break;
+        found.push_back(static_cast<size_t>(std::count(begin, hit, '\n')));
+        const char *newline = static_cast<const char *>(memchr(hit, '\n', static_cast<size_t>(end - hit)));
+        if (!newline)
+            break;
+        pos = newline + 1;
+    }
+    return found;
+}
+
+template <FixedString Source>
+static bool check(unsigned seed)
+{
+    using Static = StaticPattern<Source>;
+    std::string source(Static::source());
+    auto pattern = Pattern::compile(source);
+    if (!pattern)
+    {
+        std::printf("FAIL %s: RegParser rejects it\n", source.c_str());
+        return false;
+    }
+    Matcher matcher(pattern);
+
+    std::vector<std::string> lines = random_lines(Static::source(), seed);
+    std::string buffer;
+    size_t matched = 0;
+    for (const auto &line : lines)
+    {
+        bool expected = matcher.match(line);
+        if (Static::match(line) != expected)
+        {
+            std::printf("FAIL %s on \"%s\": StaticPattern %d, RegParser %d\n", source.c_str(), line.c_str(), !expected,
+                        expected);
+            return false;
+        }
+        matched += expected;
+        buffer += line;
+        buffer += '\n';
+    }
+
+    if (found_lines(buffer, Static::find_line) !=
+        found_lines(buffer, [&](const char *begin, const char *end) { return matcher.find_line(begin, end); }))
+    {
+        std::printf("FAIL %s: find_line picks other lines\n", source.c_str());
+        return false;
+    }
+    std::printf("ok   %-24s %5zu of %d lines match\n", source.c_str(), matched, lines_per_pattern);
+    return true;
+}
+
+int main()
+{
+    unsigned seed = 1;
+    bool ok = true;
+    ok &= check<"abc">(seed++);
+    ok &= check<"a+b">(seed++);
+    ok &= check<"a*b">(seed++);
+    ok &= check<"ab?c">(seed++);
+    ok &= check<"a.c">(seed++);
+    ok &= check<".">(seed++);
+    ok &= check<"^ab">(seed++);
+    ok &= check<"ab$">(seed++);
+    ok &= check<"^a.*b$">(seed++);
+    ok &= check<"^$">(seed++);
+    ok &= check<"[abc]+x">(seed++);
+    ok &= check<"[^abc]b">(seed++);
+    ok &= check<"[a-c0-2]{2}">(seed++);
+    ok &= check<"[-a]b">(seed++);
+    ok &= check<"[\\d.]+x">(seed++);
+    ok &= check<"\\d+a">(seed++);
+    ok &= check<"\\w\\d">(seed++);
+    ok &= check<"\\.a\\+">(seed++);
+    ok &= check<"a{2}">(seed++);
+    ok &= check<"a{2,}b">(seed++);
+    ok &= check<"a{1,3}c">(seed++);
+    ok &= check<"a+?b">(seed++);
+    ok &= check<"(ab|cd)+e">(seed++);
+    ok &= check<"(a|b)*c">(seed++);
+    ok &= check<"(a(b|c))?d">(seed++);
+    ok &= check<"((a|b)c)+$">(seed++);
+    ok &= check<"(a|b|c){2,3}$">(seed++);
+    ok &= check<"^(ab)*$">(seed++);
+    ok &= check<"x(a|b)*?y">(seed++);
+    ok &= check<"\\d{1,3}(\\.\\d{1,3}){3}">(seed++);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+#!/usr/bin/env bash
+# End-to-end checks of the CLI, run by ctest with the path of the exe target:
+#
+#   tests/cli.sh EXE
+#
+# Each check runs it once and compares its whole output with the expected one.
+
+set -u
+
+EXE=$1
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+failures=0
+
+# check NAME EXPECTED COMMAND...: stdout of COMMAND must be EXPECTED
+check()
+{
+    local name=$1 expected=$2
+    shift 2
+    local actual
+    actual=$("$@" 2>/dev/null)
+    if [ "$actual" != "$expected" ]; then
+        printf 'FAIL %s\n--- expected\n%s\n--- actual\n%s\n' "$name" "$expected" "$actual"
+        failures=$((failures + 1))
+    fi
+}
+
+# check_status NAME STATUS COMMAND...: COMMAND must exit with STATUS
+check_status()
+{
+    local name=$1 expected=$2
+    shift 2
+    "$@" >/dev/null 2>&1
+    local status=$?
+    if [ "$status" != "$expected" ]; then
+        printf 'FAIL %s: exit status %s, expected %s\n' "$name" "$status" "$expected"
+        failures=$((failures + 1))
+    fi
+}
+
+# sorted, for -r output in completion order
+sorted()
+{
+    "$@" | sort
+}
+
+lines="$TMP/lines.txt"
+printf 'one\ntwo\nthree\nfour\nfive\nsix\nseven\neight\n' > "$lines"
+
+# -- patterns: the PatternSet engines, alone and together
+
+check "literals share aho-corasick" $'one\ntwo\nsix' "$EXE" -e one -e two -e six "$lines"
+check "regexes share a union dfa" $'two\nthree\nfive' "$EXE" -e 't[hw]' -e 'f.ve' "$lines"
+check "backreference next to a literal" $'one\nthree\nfive\nsix' "$EXE" -e '(s)\1*ix' -e 'e$' "$lines"
+check "all engines" $'one\ntwo\nthree\nfive\nsix' "$EXE" -e one -e two -e '(s)\1*ix' -e 't[hw]' -e 'f.ve' "$lines"
+check "-c with several engines" 5 "$EXE" -c -e one -e two -e '(s)\1*ix' -e 't[hw]' -e 'f.ve' "$lines"
+printf 'seven\n(e)i.h\\1*t\n' > "$TMP/patterns.txt"
+check "-f" $'seven\neight' "$EXE" -f "$TMP/patterns.txt" "$lines"
+check "-E with -e" $'one\ntwo' "$EXE" -E -e one -e two "$lines"
+check "-E before the pattern" "3:three" "$EXE" -E -n 'th.ee' "$lines"
+check "pattern alone reads stdin" "aaa" bash -c "echo aaa | \"$EXE\" 'a{2}'"
+check "no pattern" "Expected a pattern" bash -c "\"$EXE\" 2>&1"
+check_status "no match" 1 "$EXE" -e nine -e ten "$lines"
+check "invalid pattern" "Unhandled pattern (" bash -c "\"$EXE\" -e one -e '(' \"$lines\" 2>&1"
+
+# -- context
+
+check "-A -B -n" $'3-three\n4:four\n5-five\n6-six\n7:seven\n8-eight' "$EXE" -n -A1 -B1 -e four -e seven "$lines"
+check "-C separates groups" $'one\ntwo\nthree\n--\nfive\nsix\nseven' "$EXE" -C1 -e two -e six "$lines"
+check "-m stops before -A" $'two\nthree' "$EXE" -m1 -A1 -e two -e six "$lines"
+check "-B across reads of a pipe" $'xx2\nfoo' \
+    bash -c "(printf 'xx1\nxx2\n'; sleep .2; printf 'foo\n'; sleep .2; printf 'xx4\n') | \"$EXE\" -B1 -e foo -e bar -e 'ba+z'"
+
+# -- -r with every io backend; completion order differs, the lines do not
+
+tree="$TMP/tree"
+mkdir -p "$tree/sub"
+expected=""
+for i in $(seq 1 120); do
+    file="$tree/f$i.txt"
+    [ $((i % 3)) = 0 ] && file="$tree/sub/f$i.txt"
+    : > "$file"
+    for j in $(seq 1 $((i % 4))); do
+        printf 'line %d\nmatch %d.%d\n' "$j" "$i" "$j" >> "$file"
+        expected+="$file:match $i.$j"$'\n'
+    done
+done
+expected=$(printf '%s' "$expected" | sort)
+for io in sync pread uring auto; do
+    check "-r --io=$io" "$expected" sorted "$EXE" -r -j4 --io="$io" --no-index 'match [0-9]+' "$tree"
+done
+check "-r --sort-files" "$(printf '%s\n' "$expected" | sort -t: -k1,1 -s)" \
+    "$EXE" -r --sort-files --no-index -e 'match [0-9]+' "$tree"
+
+# -- the trigram index: searches agree with --no-index, however stale it is
+
+printf 'gamma\n' > "$tree/sub/gamma.txt"
+check "index" "$tree: 121 files indexed, 121 read, 0 removed" "$EXE" index "$tree"
+check "indexed search" "$tree/sub/gamma.txt:gamma" "$EXE" -r gamma "$tree"
+# --stats prints a row per file read, after a header and an engine line
+check "index skips files" 3 bash -c "\"$EXE\" -r --stats gamma \"$tree\" 2>&1 >/dev/null | wc -l"
+for pattern in 'match 1[0-9]\.' 'ga(m)\1a' '(gamma|delta)' 'line [34]'; do
+    check "index agrees: $pattern" "$(sorted "$EXE" -r --no-index "$pattern" "$tree")" sorted "$EXE" -r "$pattern" "$tree"
+done
+printf 'gamma too\n' >> "$tree/f1.txt"
+printf 'gamma three\n' > "$tree/new.txt"
+rm "$tree/sub/gamma.txt"
+stale=$(printf '%s\n' "$tree/f1.txt:gamma too" "$tree/new.txt:gamma three" | sort)
+check "stale index" "$stale" sorted "$EXE" -r gamma "$tree"
+check "index update" "$tree: 121 files indexed, 2 read, 1 removed" "$EXE" index "$tree"
+check "updated index" "$stale" sorted "$EXE" -r gamma "$tree"
+check "-l with index" "$tree/new.txt" "$EXE" -r -l three "$tree"
+
+# -- --follow: appends, a line written in two parts, rotation and truncation;
+# -n counts on through all of them. Every step waits for the follower to
+# have handled the one before, however long that takes, instead of sleeping
+# for a fixed time.
+
+# wait_for FILE TEXT: polls FILE until it holds TEXT, for up to 10 seconds
+wait_for()
+{
+    local i
+    for i in $(seq 1 200); do
+        grep -qF -- "$2" "$1" 2>/dev/null && return 0
+        sleep .05
+    done
+    printf 'FAIL timed out waiting for "%s" in %s\n' "$2" "$1"
+    failures=$((failures + 1))
+    return 1
+}
+
+# wait_following PID FILE: polls until process PID has FILE open and, when
+# it uses inotify, watches it for writes, for up to 10 seconds
+wait_following()
+{
+    local i fd inode
+    inode=$(printf '%x' "$(stat -c %i "$2")")
+    for i in $(seq 1 200); do
+        local opened=0 watched=1
+        for fd in /proc/"$1"/fd/*; do
+            case $(readlink "$fd") in
+            "$2") opened=1 ;;
+            anon_inode:inotify) grep -q "ino:$inode " /proc/"$1"/fdinfo/"${fd##*/}" || watched=0 ;;
+            esac
+        done
+        [ "$opened" = 1 ] && [ "$watched" = 1 ] && return 0
+        sleep .05
+    done
+    printf 'FAIL timed out waiting for %s to follow %s\n' "$1" "$2"
+    failures=$((failures + 1))
+    return 1
+}
+
+log="$TMP/app.log"
+out="$TMP/follow.out"
+printf 'ERROR before\n' > "$log"
+"$EXE" --follow -n ERROR "$log" > "$out" 2> "$TMP/follow.err" &
+follower=$!
+wait_following "$follower" "$log"
+printf 'ERROR 1\ninfo\nERR' >> "$log"
+wait_for "$out" "ERROR 1"
+printf 'OR 3 split\nERROR 4 tail-of-old' >> "$log"
+wait_for "$out" "ERROR 3 split"
+mv "$log" "$log.1"
+printf 'ERROR 5 new\n' > "$log"
+wait_for "$out" "ERROR 5 new"
+: > "$log"
+wait_for "$TMP/follow.err" "file truncated"
+printf 'ERROR 6 after truncation\n' >> "$log"
+wait_for "$out" "ERROR 6"
+kill "$follower"
+wait "$follower" 2>/dev/null
+check "--follow" $'2:ERROR 1\n4:ERROR 3 split\n5:ERROR 4 tail-of-old\n6:ERROR 5 new\n7:ERROR 6 after truncation' \
+    cat "$out"
+
+"$EXE" --follow -m1 ERROR "$log" > "$out" 2>/dev/null &
+follower=$!
+wait_following "$follower" "$log"
+printf 'ERROR 7\nERROR 8\n' >> "$log"
+# -m1 ends the follower by itself, within 10 seconds
+for i in $(seq 1 200); do
+    kill -0 "$follower" 2>/dev/null || break
+    sleep .05
+done
+if kill -0 "$follower" 2>/dev/null; then
+    printf 'FAIL --follow -m: still running\n'
+    failures=$((failures + 1))
+    kill "$follower"
+fi
+wait "$follower" 2>/dev/null
+check "--follow -m" "ERROR 7" cat "$out"
+
+if [ "$failures" != 0 ]; then
+    echo "$failures check(s) failed"
+    exit 1
+fi
+echo "all checks passed"
@@ -0,0 +1,25 @@
+#!/usr/bin/env bash
+# Installs the library from a build tree into a scratch prefix and builds
+# tests/install against it through find_package(regparser), as a program
+# embedding it would; run by ctest:
+#
+#   tests/install.sh CMAKE CXX BUILD_DIR
+
+set -eu
+
+CMAKE=$1
+CXX=$2
+BUILD=$3
+SOURCE=$(cd "$(dirname "$0")/install" && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+"$CMAKE" --install "$BUILD" --prefix "$TMP/prefix" >/dev/null
+"$CMAKE" -S "$SOURCE" -B "$TMP/build" -DCMAKE_CXX_COMPILER="$CXX" -DCMAKE_PREFIX_PATH="$TMP/prefix" >/dev/null
+"$CMAKE" --build "$TMP/build"
+
+"$TMP/build/consumer"
+if [ -x "$TMP/build/consumer_shared" ]; then
+    "$TMP/build/consumer_shared"
+fi
+echo "installed library builds and runs"
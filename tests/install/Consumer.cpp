@@ -0,0 +1,42 @@
+// Uses every installed header the way a program embedding the library would:
+// a Pattern shared through Matchers, and the same pattern as a StaticPattern.
+
+#include "Pattern.h"
+#include "StaticPattern.h"
+
+#include <cstdio>
+#include <string_view>
+
+static_assert(StaticPattern<"ERROR \\d+">::match("x ERROR 42"));
+
+int main()
+{
+    auto pattern = Pattern::compile("ERROR \\d+");
+    if (!pattern)
+    {
+        std::printf("FAIL: the pattern does not compile\n");
+        return 1;
+    }
+    Matcher matcher(pattern);
+
+    const std::string_view lines[] = {"x ERROR 42 y", "ERROR x", "no error", "ERROR 7"};
+    for (std::string_view line : lines)
+    {
+        bool expected = matcher.match(line);
+        if (StaticPattern<"ERROR \\d+">::match(line) != expected)
+        {
+            std::printf("FAIL \"%.*s\": StaticPattern and Matcher disagree\n", static_cast<int>(line.size()),
+                        line.data());
+            return 1;
+        }
+    }
+
+    MatchResult result;
+    if (!matcher.find(lines[0], 0, result) || result.span().begin != 2 || result.span().end != 10)
+    {
+        std::printf("FAIL: find() reports the wrong span\n");
+        return 1;
+    }
+    std::printf("ok\n");
+    return 0;
+}